@@ -1,14 +1,31 @@
 #version 330 core
 layout (location = 0) in vec2 i_pos;
+layout (location = 1) in float i_x;
+layout (location = 2) in float i_begin;
+layout (location = 3) in float i_duration;
+layout (location = 4) in vec4 i_color;
 
 uniform mat4 u_mat;
-uniform float u_offset;
+uniform float u_time;
+uniform float u_width;
 uniform float u_yscale;
 uniform float u_cutoff;
 
 out vec2 p_xy;
+out vec4 p_color;
 
 void main() {
-	p_xy = vec2(i_pos.x, (i_pos.y - u_offset) * u_yscale + u_cutoff);
+	// Notes that have ended are collapsed instead of drawn behind the piano
+	if (i_begin + i_duration <= u_time) {
+		p_xy = vec2(0.0);
+		p_color = vec4(0.0);
+		gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	float y = -i_pos.y * i_duration - (i_begin - u_time);
+
+	p_xy = vec2(i_x + i_pos.x * u_width, y * u_yscale + u_cutoff);
+	p_color = i_color;
 	gl_Position = u_mat * vec4(p_xy, 0.0, 1.0);
 }
@@ -2,22 +2,35 @@
 
 #include <Logger.h>
 
+#include "offline_renderer.h"
+#include "replay_serial.h"
 #include "serial_parser.h"
-#include "windows_serial.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <filesystem>
 
 #include "app_audio_thread.h"
 #include "app_serial_thread.h"
 
-#include <MidiFile.h>
-
 namespace {
+#if defined(_WIN32)
+constexpr static const char *DEFAULT_PORT = "COM8";
+
 struct PortValidator : public CLI::Validator {
 	PortValidator()
 	{
-		name_ = "PORT";
-		func_ = [](const std::string &str) {
+		name_ = "PORT[:OFFSET]";
+		func_ = [](const std::string &spec) {
+			SerialPortSpec parsed;
+			if (!parsePortSpec(spec, parsed))
+				return std::string("Invalid port.");
+
+			if (parsed.port.rfind(ReplaySerial::PORT_PREFIX, 0) == 0)
+				return CLI::ExistingFile(parsed.port.substr(std::string(ReplaySerial::PORT_PREFIX).size()));
+
+			const auto &str = parsed.port;
 			const auto com_part = str.substr(0, 3);
 			const auto number_part = str.substr(3);
 
@@ -32,38 +45,60 @@ struct PortValidator : public CLI::Validator {
 		};
 	}
 };
+#else
+constexpr static const char *DEFAULT_PORT = "/dev/ttyUSB0";
+
+struct PortValidator : public CLI::Validator {
+	PortValidator()
+	{
+		name_ = "PORT[:OFFSET]";
+		func_ = [](const std::string &spec) {
+			SerialPortSpec parsed;
+			if (!parsePortSpec(spec, parsed))
+				return std::string("Invalid port.");
+
+			if (parsed.port.rfind(ReplaySerial::PORT_PREFIX, 0) == 0)
+				return CLI::ExistingFile(parsed.port.substr(std::string(ReplaySerial::PORT_PREFIX).size()));
 
-std::vector<AppGraphics::MidiNote> loadNotesFromFile(const std::string &path, int transpose)
+			return CLI::ExistingFile(parsed.port);
+		};
+	}
+};
+#endif
+
+SongLoader::Options songOptions(const AppCommandLine &arguments)
 {
-	smf::MidiFile midifile;
-	midifile.read(path);
+	return SongLoader::Options{arguments.midi, arguments.midi_transpose, AppGraphics::STARTING_NOTE, AppGraphics::ENDING_NOTE, arguments.songCache};
+}
 
-	midifile.doTimeAnalysis();
-	midifile.linkNotePairs();
+//! The notes of the given tracks, or of every track if none are given, timed for the audio
+//! output and in the order Audio::playSong() takes them
+std::vector<Audio::SongNote> songFromNotes(const SongTimeline &notes, const std::vector<int> &tracks)
+{
+	const auto toFrame = [](double seconds) { return std::uint64_t(std::llround(std::max(0.0, seconds) * double(Instrument::SAMPLE_RATE))); };
 
-	std::vector<AppGraphics::MidiNote> result;
+	std::vector<Audio::SongNote> presses, releases;
+	presses.reserve(notes.size());
+	releases.reserve(notes.size());
 
-	for (int track = 0; track < midifile.getTrackCount(); track++) {
-		result.reserve(midifile[track].size());
+	for (std::size_t i = 0; i < notes.size(); i++) {
+		if (!tracks.empty() && std::find(tracks.begin(), tracks.end(), int(notes.tracks[i])) == tracks.end())
+			continue;
 
-		for (int ev = 0; ev < midifile[track].size(); ev++) {
-			if (midifile[track][ev].isNoteOn()) {
-				const Note note = Note::fromMidi(midifile[track][ev][1] + transpose);
+		const std::uint64_t on = toFrame(notes.begins[i]);
 
-				if (note >= AppGraphics::STARTING_NOTE && note <= AppGraphics::ENDING_NOTE) {
-					result.push_back(AppGraphics::MidiNote{
-					    note,
-					    (float)midifile[track][ev].seconds,
-					    (float)midifile[track][ev].getDurationInSeconds()});
-				}
-				else {
-					std::cerr << "Note " << note << " on track " << track << " (event " << ev << ") is invalid." << std::endl;
-				}
-			}
-		}
+		presses.push_back(Audio::SongNote{on, notes.note(i), true});
+		releases.push_back(Audio::SongNote{std::max(on + 1, toFrame(double(notes.begins[i]) + double(notes.durations[i]))), notes.note(i), false});
 	}
 
-	result.shrink_to_fit();
+	const auto earlier = [](const Audio::SongNote &a, const Audio::SongNote &b) { return a.frame < b.frame; };
+
+	// The timeline is in order of start, so only the releases need sorting
+	std::stable_sort(releases.begin(), releases.end(), earlier);
+
+	// A note released on the frame another one starts is released first
+	std::vector<Audio::SongNote> result(presses.size() + releases.size());
+	std::merge(releases.begin(), releases.end(), presses.begin(), presses.end(), result.begin(), earlier);
 
 	return result;
 }
@@ -74,19 +109,38 @@ std::vector<AppGraphics::MidiNote> loadNotesFromFile(const std::string &path, in
 PianoApp::PianoApp() : commandLine("Piano app"), data()
 {
 	data.state = AppState::SETUP;
+	data.accompaniment.pending = false;
+	data.accompaniment.stop = false;
 
-	arguments.port = "COM8";
+	arguments.ports = {DEFAULT_PORT};
 	arguments.baud = 115200;
 	arguments.serialSettings = Serial::ARDUINO_SETTINGS;
+	arguments.protocol = SerialParser::PROTOCOL_AUTO;
+	arguments.serialReport = 0;
+	arguments.replaySpeed = 1.0;
 	arguments.volume = 0.3f;
+	arguments.audioSettings.polyphony = Audio::DEFAULT_POLYPHONY;
+	arguments.audioSettings.scalar_kernel = false;
+	arguments.audioSettings.fluid_polyphony = 0;
+	arguments.audioSettings.period_size = 0;
+	arguments.audioSettings.periods = 0;
+	arguments.audioSettings.cpu_cores = 0;
+	arguments.audioSettings.latency_ms = Audio::DEFAULT_LATENCY_MS;
+	arguments.audioSettings.output = Audio::OUTPUT_DEVICE;
+	arguments.audioSettings.file = "piano.wav";
 #if PIANO_AL_ENABLED
-	arguments.playback = Audio::PLAYBACK_SINE;
+	arguments.audioSettings.playback = Audio::PLAYBACK_SINE;
 #else
-	arguments.playback = Audio::PLAYBACK_MIDI;
+	arguments.audioSettings.playback = Audio::PLAYBACK_MIDI;
 #endif
 	arguments.countdown = 3;
 	arguments.yscale = 100.0f;
 	arguments.midi_transpose = 0;
+	arguments.accompany = false;
+
+	std::error_code error;
+	const auto temporary = std::filesystem::temp_directory_path(error);
+	arguments.songCache = error ? std::string() : (temporary / "piano").string();
 
 	Logger::console = Logger::openStaticOutputStream(std::cout);
 	Logger::logLevel = Logger::Level::LVL_INFO;
@@ -97,23 +151,57 @@ bool PianoApp::initCommandLine(int argc, const char *argv[])
 	commandLine.add_option("-m,--midi,--midifile,--mid", arguments.midi, "The midi file to open")
 	    ->check(CLI::ExistingFile);
 
-	commandLine.add_option("-f,--sf,--soundfont", arguments.soundfont, "The soundfont file to open")
+	commandLine.add_option("-f,--sf,--soundfont", arguments.audioSettings.soundfont, "The soundfont file to open. It's loaded in the background")
 	    ->check(CLI::ExistingFile);
 
 	commandLine.add_option("--midi-transpose,--transpose", arguments.midi_transpose, "The number of midi notes to transpose by");
 
+	commandLine.add_option("--song-cache", arguments.songCache, "The directory where parsed midi files are kept for the next launch. Empty to parse the file every time")
+	    ->capture_default_str();
+
 	commandLine.add_option("--countdown", arguments.countdown, "The countdown before starting the song")
 	    ->check(CLI::Range(0u, 9u, "COUNTDOWN"));
 
 	commandLine.add_option("--yscale", arguments.yscale, "The vertical stretching of bars. Given in the units of pixel/second.")
 	    ->check(CLI::Range(1.0f, INFINITY, "YSCALE"));
 
-	commandLine.add_option("--playback", arguments.playback, "The playback mode.")
+	commandLine.add_option("--render", arguments.render, "Render the midi file with the playback's waveform to this WAV file as fast as possible and exit")
+	    ->needs("--midi");
+
+	commandLine.add_flag("--render-scalar", arguments.audioSettings.scalar_kernel, "Render with the scalar synth kernel, so the file is the same on every CPU")
+	    ->needs("--render");
+
+	commandLine.add_flag("--accompany", arguments.accompany, "Play the midi file along with the keyboard after the countdown");
+
+	commandLine.add_option("--accompany-tracks", arguments.accompanyTracks, "Only play these tracks of the midi file along. Implies --accompany")
+	    ->delimiter(',')
+	    ->each([this](const std::string &) { arguments.accompany = true; });
+
+	commandLine.add_option("--playback", arguments.audioSettings.playback, "The playback mode.")
 	    ->transform(CLI::CheckedTransformer(Audio::PLAYBACK_MAP, CLI::ignore_case));
 
-	commandLine.add_option("-p,--port", arguments.port, "The serial port to connect to")
+	commandLine.add_option("--samples", arguments.audioSettings.samples, "The directory of WAV recordings played by --playback samples, named like C4.wav, 60.wav or C#4_v80.wav")
+	    ->check(CLI::ExistingDirectory);
+
+	commandLine.add_option("--audio-output", arguments.audioSettings.output, "Where the sound goes: device, null to play nothing, or wav to record the instrument to --audio-file")
+	    ->transform(CLI::CheckedTransformer(Audio::OUTPUT_MAP, CLI::ignore_case));
+
+	commandLine.add_option("--audio-latency", arguments.audioSettings.latency_ms, "Milliseconds of audio the waveforms and samples keep queued on the sound card. Lower reacts faster but may crackle")
+	    ->check(CLI::Range(5u, 500u));
+
+	commandLine.add_option("--audio-file", arguments.audioSettings.file, "The WAV file written by --audio-output wav");
+
+	commandLine.add_option("-p,--port", arguments.ports, "The serial ports to connect to. A port may be followed by the number of semitones to shift its keys by, e.g. COM4:-12. Use replay:FILE to play back a recording")
+	    ->delimiter(',')
 	    ->check(PortValidator());
 
+	commandLine.add_option("--record", arguments.record, "Record the raw input of the serial ports to this file. With several ports the port's index is appended");
+
+	commandLine.add_option("--replay-speed", arguments.replaySpeed, "The speed of ports given as replay:FILE. 1 is the original speed, 0 is as fast as possible")
+	    ->check(CLI::NonNegativeNumber);
+
+	commandLine.add_option("--serial-report", arguments.serialReport, "Print per port statistics every given number of seconds. 0 only prints them on exit");
+
 	commandLine.add_option("-b,--baud", arguments.baud, "The baud rate of the serial connection");
 
 	commandLine.add_option("-s,--stop_bits,--stop", arguments.serialSettings.stop_bits, "The number of stop bits")
@@ -122,8 +210,28 @@ bool PianoApp::initCommandLine(int argc, const char *argv[])
 	commandLine.add_option("--par,--parity", arguments.serialSettings.parity, "The parity bit. N for none, E for even, O for odd")
 	    ->transform(CLI::CheckedTransformer(Serial::PARITY_MAP, CLI::ignore_case));
 
+	commandLine.add_option("--protocol", arguments.protocol, "The scan format sent by the keyboard: ascii, binary or auto")
+	    ->transform(CLI::CheckedTransformer(SerialParser::PROTOCOL_MAP, CLI::ignore_case));
+
+	commandLine.add_option("-k,--keymap", arguments.keymap, "The file describing the keyboard's scan matrix. The built-in layout is used if not given")
+	    ->check(CLI::ExistingFile);
+
 	commandLine.add_option("--bs,--byte_size", arguments.serialSettings.byte_size, "The number of bits");
 	commandLine.add_option("--volume,-v", arguments.volume, "The volume in the range [0-1]");
+	commandLine.add_option("--polyphony", arguments.audioSettings.polyphony, "The most notes the waveforms or samples sound at once. Further notes stop the oldest one")
+	    ->check(CLI::Range(1u, Audio::MAX_POLYPHONY));
+
+	commandLine.add_option("--fluid-polyphony", arguments.audioSettings.fluid_polyphony, "Voices FluidSynth plays at once. A note of a layered preset takes several")
+	    ->check(CLI::Range(1u, 65535u));
+
+	commandLine.add_option("--fluid-period-size", arguments.audioSettings.period_size, "Frames FluidSynth renders per callback. Smaller lowers the latency of the soundfont")
+	    ->check(CLI::Range(64u, 8192u));
+
+	commandLine.add_option("--fluid-periods", arguments.audioSettings.periods, "Buffers FluidSynth keeps queued on the sound card. Fewer lowers the latency but may crackle")
+	    ->check(CLI::Range(2u, 64u));
+
+	commandLine.add_option("--fluid-cores", arguments.audioSettings.cpu_cores, "Threads FluidSynth renders voices on")
+	    ->check(CLI::Range(1u, 256u));
 
 	try {
 		commandLine.parse(argc, argv);
@@ -141,7 +249,7 @@ bool PianoApp::initCommandLine(int argc, const char *argv[])
 
 bool PianoApp::initAudio()
 {
-	m_openal_thread_handle = std::thread(openal_thread, &data, arguments.volume, arguments.playback, arguments.soundfont);
+	m_audio_thread_handle = std::thread(audio_thread, arguments, &data);
 
 	std::unique_lock lock(data.condition_variables.al_done_mutex);
 	data.condition_variables.al_done.wait_for(lock, std::chrono::seconds(5));
@@ -149,6 +257,12 @@ bool PianoApp::initAudio()
 	return data.state == AppState::RUNNING;
 }
 
+void PianoApp::loadSong()
+{
+	if (!arguments.midi.empty())
+		m_song.start(songOptions(arguments));
+}
+
 bool PianoApp::initGraphics()
 {
 	//! @todo strings
@@ -169,16 +283,74 @@ bool PianoApp::initSerial()
 	return data.state == AppState::RUNNING;
 }
 
+bool PianoApp::render()
+{
+	if (arguments.audioSettings.playback == Audio::PLAYBACK_MIDI)
+		std::cerr << "The soundfont can't be rendered offline, using the sine waveform." << std::endl;
+
+	auto instrument = Audio::makeInstrument(arguments.audioSettings);
+	if (!instrument)
+		return false;
+
+	OfflineRenderer renderer(std::move(instrument), arguments.volume);
+
+	SongTimeline notes;
+	if (!SongLoader::load(songOptions(arguments), notes))
+		return false;
+
+	for (std::size_t i = 0; i < notes.size(); i++)
+		renderer.addNote(notes.note(i), notes.begins[i], notes.durations[i]);
+
+	if (!renderer.render(arguments.render))
+		return false;
+
+	const auto &stats = renderer.statistics();
+
+	std::cout << "Rendered " << stats.audio_seconds << " s of audio in " << stats.wall_seconds << " s, "
+	          << stats.realTimeFactor() << "x real time." << std::endl;
+
+	return true;
+}
+
 void PianoApp::onClick(unsigned x, unsigned y, Platform::ClickType t, Platform::ClickDirection d)
 {
 	std::cout << "Click: " << x << " " << y << " t=" << (int)t << " d=" << (int)d << std::endl;
 
 	if (d == Platform::ClickDirection::DOWN && t == Platform::ClickType::LEFT) {
 		if (!m_graphics.isGameActive()) {
-			m_graphics.setNotes(loadNotesFromFile(arguments.midi, arguments.midi_transpose));
-			m_graphics.beginCountdown();
+			static const SongTimeline NO_NOTES;
+
+			if (!arguments.midi.empty() && m_song.state() != SongLoader::STATE_READY) {
+				if (m_song.state() == SongLoader::STATE_FAILED)
+					std::cerr << "The midi file couldn't be loaded." << std::endl;
+				else
+					std::cout << "The midi file is still loading." << std::endl;
+
+				return;
+			}
+
+			const auto &notes = arguments.midi.empty() ? NO_NOTES : m_song.timeline();
+
+			m_graphics.setNotes(notes);
+			const auto start = m_graphics.beginCountdown();
+
+			if (arguments.accompany) {
+				auto song = songFromNotes(notes, arguments.accompanyTracks);
+
+				{
+					std::lock_guard<std::mutex> lock(data.accompaniment.mutex);
+					data.accompaniment.notes = std::move(song);
+					data.accompaniment.start = start;
+					data.accompaniment.pending = true;
+				}
+
+				data.events.audio.notify();
+			}
 		}
 	}
+	else if (d == Platform::ClickDirection::DOWN && t == Platform::ClickType::RIGHT) {
+		data.latency.print(std::cout);
+	}
 }
 
 void PianoApp::mainLoop()
@@ -189,9 +361,12 @@ void PianoApp::mainLoop()
 void PianoApp::cleanup()
 {
 	data.state = AppState::FINISHED;
+	data.events.notify();
 
 	m_serial_thread_handle.join();
-	m_openal_thread_handle.join();
+	m_audio_thread_handle.join();
+
+	data.latency.print(std::cout);
 
 	m_graphics.end();
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "app_data.h"
 #include "serial.h"
+#include "song_loader.h"
 
 #include <CLI/CLI.hpp>
 
@@ -20,7 +21,8 @@ public:
 private:
 	AppGraphics m_graphics;
 	std::thread m_serial_thread_handle;
-	std::thread m_openal_thread_handle;
+	std::thread m_audio_thread_handle;
+	SongLoader m_song;
 
 public:
 	PianoApp();
@@ -30,6 +32,12 @@ public:
 	bool initGraphics();
 	bool initSerial();
 
+	//! Starts loading the midi file in the background
+	void loadSong();
+
+	//! Renders the midi file to arguments.render instead of running the app
+	bool render();
+
 	void onClick(unsigned x, unsigned y, Platform::ClickType t, Platform::ClickDirection d);
 
 	void mainLoop();
@@ -1,44 +1,194 @@
 #include "app_audio_thread.h"
 
-#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <array>
 
-std::unordered_set<Note> setDifference(const std::unordered_set<Note> &base, const std::unordered_set<Note> &other)
-{
-	std::unordered_set<Note> result;
-	for (const auto &item : base) {
-		if (other.count(item) == 0)
-			result.insert(item);
+namespace {
+using event_clock = NoteEvent::clock;
+
+//! The longest the thread sleeps without a key change, to notice the app finishing
+constexpr static const auto HOUSEKEEPING_INTERVAL = std::chrono::milliseconds(100);
+
+//! Plays note events so that each note sounds for as long as its key was held,
+//! even when the release arrives in the same batch as the press
+class EventPlayer {
+private:
+	Audio *m_audio;
+
+	Sounds::Snapshot m_playing;
+	//! Released keys whose notes haven't sounded for the full hold time yet
+	Sounds::Snapshot m_pending_stops;
+	//! Keys held in the last resync()'s snapshot and not released since. Their presses
+	//! may still be queued, and mustn't start the note again.
+	Sounds::Snapshot m_resynced;
+
+	std::array<event_clock::time_point, Sounds::NUM_NOTES> m_pressed_at;
+	std::array<event_clock::time_point, Sounds::NUM_NOTES> m_started_at;
+	std::array<event_clock::time_point, Sounds::NUM_NOTES> m_stop_at;
+
+	void stop(Note note)
+	{
+		m_audio->stopNote(note);
+		m_playing.set(note, false);
+		m_pending_stops.set(note, false);
 	}
 
-	return result;
-}
+public:
+	EventPlayer(Audio *audio) : m_audio(audio), m_playing(), m_pending_stops(), m_resynced(), m_pressed_at(), m_started_at(), m_stop_at() {}
+
+	void press(Note note, event_clock::time_point pressed, event_clock::time_point now)
+	{
+		// Already covered by the snapshot the notes were resynced from
+		if (m_resynced.test(note)) {
+			m_resynced.set(note, false);
+			return;
+		}
+
+		const std::size_t index = Sounds::Snapshot::index(note);
+
+		// Pressed again before the last press finished sounding
+		if (m_playing.test(note))
+			stop(note);
+
+		m_audio->playNote(note);
+		m_playing.set(note);
+		m_pressed_at[index] = pressed;
+		m_started_at[index] = now;
+	}
+
+	void release(Note note, event_clock::time_point released, event_clock::time_point now)
+	{
+		m_resynced.set(note, false);
+
+		if (!m_playing.test(note))
+			return;
+
+		const std::size_t index = Sounds::Snapshot::index(note);
+		const auto stop_at = m_started_at[index] + (released - m_pressed_at[index]);
+
+		if (stop_at <= now) {
+			stop(note);
+		}
+		else {
+			m_pending_stops.set(note);
+			m_stop_at[index] = stop_at;
+		}
+	}
+
+	void handle(const NoteEvent &event, event_clock::time_point now)
+	{
+		if (event.on)
+			press(event.note, event.time, now);
+		else
+			release(event.note, event.time, now);
+	}
+
+	//! Stops the released notes that have sounded long enough
+	void stopDue(event_clock::time_point now)
+	{
+		m_pending_stops.forEach([this, now](Note note) {
+			if (m_stop_at[Sounds::Snapshot::index(note)] <= now)
+				stop(note);
+		});
+	}
 
-void openal_thread(AppData *data, float volume, Audio::Playback playback, std::string soundfont)
+	//! When the next pending stop is due
+	event_clock::time_point nextStop() const
+	{
+		auto result = event_clock::time_point::max();
+
+		m_pending_stops.forEach([this, &result](Note note) {
+			result = std::min(result, m_stop_at[Sounds::Snapshot::index(note)]);
+		});
+
+		return result;
+	}
+
+	//! After events were lost, makes the playing notes match the keyboard
+	void resync(const Sounds::Snapshot &keys, event_clock::time_point now)
+	{
+		const auto changed = keys ^ m_playing;
+
+		m_resynced = Sounds::Snapshot{};
+
+		(changed & m_playing).forEach([this](Note note) { stop(note); });
+		(changed & keys).forEach([this, now](Note note) { press(note, now, now); });
+		(keys & m_pending_stops).forEach([this](Note note) { m_pending_stops.set(note, false); });
+
+		m_resynced = keys;
+	}
+};
+} // namespace
+
+void audio_thread(const AppCommandLine &commandLine, AppData *data)
 {
-	if (!data->audio.begin(playback, soundfont)) {
+	if (!data->audio.begin(commandLine.audioSettings)) {
 		data->state = AppState::FINISHED;
 	}
 	else {
-		data->audio.setVolume(volume);
+		data->audio.setVolume(commandLine.volume);
 	}
 
 	data->condition_variables.al_done.notify_one();
 
+	auto &channel = data->events.audio;
+	EventPlayer player(&data->audio);
+	NoteEvent event;
+
+	bool loading = data->audio.state() == AudioBackend::STATE_LOADING;
+	if (loading)
+		std::cout << "Loading the soundfont, keys are silent until it's done." << std::endl;
+
 	while (data->state == AppState::RUNNING) {
-		const auto playedNotes = data->audio.getActiveNotes();
-		const auto localSounds = data->sounds.toNotes();
+		const auto now = event_clock::now();
+
+		// Checked on every wakeup, at least once per housekeeping interval
+		if (loading && data->audio.state() != AudioBackend::STATE_LOADING) {
+			loading = false;
+
+			if (data->audio.state() == AudioBackend::STATE_FAILED) {
+				data->state = AppState::FINISHED;
+				break;
+			}
+		}
+
+		if (channel.overflowed.exchange(false)) {
+			while (channel.queue.pop(event)) {}
+
+			// Presses published after the drain may already be in the snapshot; the
+			// player skips those instead of starting the notes twice
+			player.resync(data->sounds.snapshot(), now);
+		}
+
+		while (channel.queue.pop(event)) {
+			player.handle(event, now);
+
+			data->latency.record(LatencyTrace::STAGE_DECODE, event.time, event.decoded);
+			data->latency.record(LatencyTrace::STAGE_SOUNDS, event.time, event.applied);
+
+			if (event.on)
+				data->latency.record(LatencyTrace::STAGE_AUDIO, event.time, event_clock::now());
+		}
+
+		player.stopDue(now);
+
+		if (data->accompaniment.stop.exchange(false))
+			data->audio.stopSong();
 
-		std::unordered_set<Note> locallyAvailableButNotPlayed = setDifference(localSounds, playedNotes),
-		                         playedButNotLocallyAvailable = setDifference(playedNotes, localSounds);
+		if (data->accompaniment.pending) {
+			std::lock_guard<std::mutex> lock(data->accompaniment.mutex);
 
-		for (const auto &noteToStop : playedButNotLocallyAvailable)
-			data->audio.stopNote(noteToStop);
+			data->audio.playSong(std::move(data->accompaniment.notes), data->accompaniment.start);
+			data->accompaniment.notes.clear();
+			data->accompaniment.pending = false;
+		}
 
-		for (const auto &noteToPlay : locallyAvailableButNotPlayed)
-			data->audio.playNote(noteToPlay);
+		const auto next_song_note = data->audio.updateSong(event_clock::now());
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		channel.waitUntil(std::min({player.nextStop(), next_song_note, event_clock::now() + HOUSEKEEPING_INTERVAL}));
 	}
 
+	data->audio.stopSong();
 	data->audio.end();
 }
@@ -4,6 +4,7 @@
 #include "app_data.h"
 #include "audio.h"
 
-void openal_thread(AppData *data, float volume, Audio::Playback playback, std::string soundfont);
+//! Starts the audio backend and plays the keyboard's note events on it
+void audio_thread(const AppCommandLine &commandLine, AppData *data);
 
 #endif // !defined(PIANO_APP_AUDIO_THREAD_H)
\ No newline at end of file
@@ -2,11 +2,17 @@
 #define PIANO_APP_DATA_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include "audio.h"
+#include "latency.h"
+#include "note_events.h"
 #include "serial.h"
+#include "serial_parser.h"
 #include "sounds.h"
 
 enum AppState {
@@ -28,9 +34,23 @@ struct AppConditionVars {
 	std::condition_variable serial_done, al_done;
 };
 
+//! A song handed from the UI thread to the audio thread to play along with the keyboard
+struct AppAccompaniment {
+	std::mutex mutex;
+	//! Set with the mutex held, so the audio thread only locks it when there's a song
+	std::atomic_bool pending;
+	std::vector<Audio::SongNote> notes;
+	std::chrono::steady_clock::time_point start;
+	//! Set when the round ends, so the accompaniment stops with it
+	std::atomic_bool stop;
+};
+
 struct AppData {
 	Audio audio;
 	Sounds sounds;
+	NoteEventQueues events;
+	LatencyTrace latency;
+	AppAccompaniment accompaniment;
 	AppConditionVars condition_variables;
 
 	std::atomic_int state;
@@ -39,15 +59,23 @@ struct AppData {
 
 struct AppCommandLine {
 	std::string midi;
-	std::string port;
+	std::vector<std::string> ports;
 	unsigned int baud;
 	Serial::Settings serialSettings;
+	SerialParser::Protocol protocol;
+	std::string keymap;
+	unsigned int serialReport;
+	std::string record;
+	double replaySpeed;
 	float volume;
-	Audio::Playback playback;
+	Audio::Settings audioSettings;
 	float yscale;
 	unsigned int countdown;
 	int midi_transpose;
-	std::string soundfont;
+	std::string songCache;
+	std::string render;
+	bool accompany;
+	std::vector<int> accompanyTracks;
 };
 
 #endif // !defined(PIANO_APP_DATA_H)
\ No newline at end of file
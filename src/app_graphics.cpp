@@ -1,6 +1,9 @@
 #include "app_graphics.h"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <sstream>
 #include <thread>
 
@@ -35,12 +38,28 @@ Neon::ShaderComponentPtr loadMidiShader()
 	shader->addLocalNode(ResourceLoader::loadShaderStage("fragment", GL_FRAGMENT_SHADER, "data/midi.fragment.glsl"));
 	shader->link();
 	shader->bindAttribLocation(0, "i_pos");
-	shader->addLocalNode(UniformComponent::create("u_offset"));
+	shader->addLocalNode(UniformComponent::create("u_time"));
+	shader->addLocalNode(UniformComponent::create("u_width"));
 	shader->addLocalNode(UniformComponent::create("u_yscale"));
 	shader->addLocalNode(UniformComponent::create("u_cutoff"));
 	shader->addLocalNode(UniformComponent::create("u_mat"));
 	return shader;
 }
+
+//! The hue the notes have always had across the keyboard, as the fragment shader computed it
+void hueToColor(float hue, std::uint8_t color[4])
+{
+	static const float SHIFTS[] = {1.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+	for (unsigned i = 0; i < 3; i++) {
+		const float shifted = hue + SHIFTS[i];
+		const float channel = std::abs((shifted - std::floor(shifted)) * 6.0f - 3.0f) - 1.0f;
+
+		color[i] = std::uint8_t(std::min(1.0f, std::max(0.0f, channel)) * 255.0f + 0.5f);
+	}
+
+	color[3] = 255;
+}
 } // namespace
 
 /* static */ float AppGraphics::calculateNoteXPosition(Note note, float maxwidth)
@@ -67,67 +86,6 @@ Neon::ShaderComponentPtr loadMidiShader()
 	return (PIANO_WIDTH_MULTIPLIER / float(num_full_keys));
 }
 
-Neon::EngineObjectPtr AppGraphics::createMidiObject(Note note, float timestamp, float duration)
-{
-	using namespace Neon;
-	using namespace cppx;
-
-	const bool is_sharp = note.isSharp();
-
-	const float width = m_maxkeywidth * NOTE_WIDTH_MULTIPLIER;
-	const float offset_x = calculateNoteXPosition(note, m_maxkeywidth) + (is_sharp ? -width * 0.5f : 0.0f);
-	const float base_y = 0.0;
-	const float extent_y = -duration;
-
-	const float mesh[] = {
-	    offset_x, base_y,
-	    offset_x + width, base_y,
-	    offset_x + width, extent_y,
-	    offset_x, extent_y};
-
-	static const unsigned idx[] = {0, 1, 2, 2, 3, 0};
-
-	auto obj = EngineObject::create("midi_" + std::to_string(note.toMidi()) + "_" + std::to_string(timestamp));
-
-	obj->addLocalNode(RenderComponent::create("midi_render"));
-	obj->addNode("midi_render",
-	             MeshComponent::create(
-	                 "midi_mesh",
-	                 Buffer::Static((void *)mesh, sizeof(mesh)),
-	                 MeshComponent::LayoutList{{0, 2, GL_FLOAT, GL_FALSE, 0}},
-	                 Buffer::Static((void *)idx, sizeof(idx))));
-
-	obj->addLocalNode(m_midishader);
-
-	auto su_mat = Neon::UniformStorageComponent::create("su_mat", m_midishader->getNodeByPath<Neon::UniformComponent>("$u_mat"));
-	su_mat->set(Calcda::Matrix4::orthographic(0.0, 1.0, 0.0, m_resolution.y, -1.0, 1.0).transpose());
-	obj->addLocalNode(su_mat);
-
-	auto su_offset = Neon::UniformStorageComponent::create("su_offset", m_midishader->getNodeByPath<Neon::UniformComponent>("$u_offset"));
-	su_offset->set(timestamp);
-	obj->addLocalNode(su_offset);
-
-	auto su_yscale = Neon::UniformStorageComponent::create("su_yscale", m_midishader->getNodeByPath<Neon::UniformComponent>("$u_yscale"));
-	su_yscale->set(m_yscale);
-	obj->addLocalNode(su_yscale);
-
-	auto su_cutoff = Neon::UniformStorageComponent::create("su_cutoff", m_midishader->getNodeByPath<Neon::UniformComponent>("$u_cutoff"));
-	su_cutoff->set(m_resolution.y - PIANO_HEIGHT_PIXELS);
-	obj->addLocalNode(su_cutoff);
-
-	auto normalAssoc = obj->createAssociation("assoc_normal");
-	normalAssoc->setRender("midi_render");
-	normalAssoc->setShader(m_midishader);
-	normalAssoc->addUniformStorages(su_mat, su_offset, su_yscale, su_cutoff);
-	normalAssoc->renderPass = -1;
-
-	obj->zIndex = 0;
-
-	obj->visible = true;
-
-	return obj;
-}
-
 Neon::EngineObjectPtr AppGraphics::createKeyObject(Note note, float x)
 {
 	using namespace Neon;
@@ -196,7 +154,18 @@ void AppGraphics::initGraphics()
 	neon->options.backgroundColor = {0.1f, 0.1f, 0.1f, 1.0f};
 	neon->options.clear = true;
 
-	neon->onSwapBuffers = [this]() -> void { SwapBuffers(this->m_platform_context.hdc); };
+	// The notes go on top of the finished frame, in one draw call of their own
+	neon->onSwapBuffers = [this]() -> void {
+		m_note_field.draw();
+		SwapBuffers(this->m_platform_context.hdc);
+
+		const auto now = NoteEvent::clock::now();
+
+		for (const auto pressed : m_undisplayed_presses)
+			data->latency.record(LatencyTrace::STAGE_DISPLAY, pressed, now);
+
+		m_undisplayed_presses.clear();
+	};
 	neon->applyOptions();
 
 	m_piano_scene = Node::create("piano_scene");
@@ -211,6 +180,20 @@ void AppGraphics::initShaders()
 	m_midishader = loadMidiShader();
 }
 
+void AppGraphics::initNoteField()
+{
+	using namespace Neon;
+
+	// Nothing but the time changes while the song plays
+	m_midishader->use();
+	m_midishader->getNodeByPath<UniformComponent>("$u_mat")->upload(Calcda::Matrix4::orthographic(0.0, 1.0, 0.0, m_resolution.y, -1.0, 1.0).transpose());
+	m_midishader->getNodeByPath<UniformComponent>("$u_width")->upload(m_maxkeywidth * NOTE_WIDTH_MULTIPLIER);
+	m_midishader->getNodeByPath<UniformComponent>("$u_yscale")->upload(m_yscale);
+	m_midishader->getNodeByPath<UniformComponent>("$u_cutoff")->upload(m_resolution.y - PIANO_HEIGHT_PIXELS);
+
+	m_note_field.begin(m_midishader);
+}
+
 void AppGraphics::mainLoop(Platform::Win32::PlatformContext *const context)
 {
 	if (data->state != AppState::RUNNING) {
@@ -312,47 +295,60 @@ void AppGraphics::updateMidi()
 	if (m_midi_data.active) {
 		const auto now = clock::now();
 		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_midi_data.playing_started).count() / 1000.0f;
-		int i = 0;
 
-		while (i < m_midi_note_pairs.size()) {
-			auto &note_pair = m_midi_note_pairs[i];
+		// The space above the piano reaches this far into the song
+		const float horizon = elapsed + (m_resolution.y - PIANO_HEIGHT_PIXELS) / m_yscale;
 
-			const auto valid = note_pair.second != nullptr;
-			const auto visible = (note_pair.first.begin - elapsed) < 8.0f && (note_pair.first.begin + note_pair.first.duration - elapsed) > 0.0f;
+		// Every note before first has ended, every note from last starts past the window.
+		// The window holds the notes starting from the longest duration before now to the
+		// horizon, so each frame costs O(log N) plus the notes in that range.
+		const std::size_t ended = std::upper_bound(m_midi_reach.begin(), m_midi_reach.end(), elapsed) - m_midi_reach.begin();
+		const std::size_t started = std::lower_bound(m_midi_begins.begin(), m_midi_begins.end(), elapsed - m_midi_longest) - m_midi_begins.begin();
+		const std::size_t first = std::max(ended, started);
+		const std::size_t last = std::lower_bound(m_midi_begins.begin(), m_midi_begins.end(), horizon) - m_midi_begins.begin();
 
-			if (visible) {
-				if (!valid) {
-					note_pair.second = createMidiObject(note_pair.first.n, note_pair.first.begin, note_pair.first.duration);
-					m_piano_scene->addLocalNode(note_pair.second);
-				}
+		m_note_field.setWindow(first, last > first ? last - first : 0, elapsed);
 
-				const float offset = note_pair.first.begin - elapsed;
+		// Every note has scrolled off by then
+		if (elapsed > (m_midi_reach.empty() ? 0.0f : m_midi_reach.back())) {
+			m_midi_data.active = false;
+			m_note_field.setWindow(0, 0, elapsed);
 
-				note_pair.second->getNodeByPath<Neon::UniformStorageComponent>("su_offset")->set(offset);
-			}
-
-			if (!visible && valid) {
-				m_piano_scene->removeLocalNode(note_pair.second);
-				note_pair.second = nullptr;
-				m_midi_note_pairs.erase(m_midi_note_pairs.begin() + i);
-
-				if (m_midi_note_pairs.empty())
-					m_midi_data.active = false;
-			}
-			else {
-				i++;
-			}
+			data->accompaniment.stop = true;
+			data->events.audio.notify();
 		}
 	}
 }
 
 void AppGraphics::updateKeys()
 {
-	const auto localSounds = data->sounds.toNotes();
+	auto &channel = data->events.graphics;
+	NoteEvent event;
+
+	if (channel.overflowed.exchange(false)) {
+		while (channel.queue.pop(event)) {}
+
+		m_held_keys = data->sounds.snapshot();
+	}
+
+	// Keys pressed and released since the last frame are still shown for this one
+	Sounds::Snapshot tapped_keys{};
+
+	while (channel.queue.pop(event)) {
+		m_held_keys.set(event.note, event.on);
+
+		// Measured once the frame showing the press is handed to the display
+		if (event.on) {
+			tapped_keys.set(event.note);
+			m_undisplayed_presses.push_back(event.time);
+		}
+	}
+
+	const auto shownKeys = m_held_keys | tapped_keys;
 
 	for (Note n = STARTING_NOTE; n <= ENDING_NOTE; n = Note::fromMidi(n.toMidi() + 1)) {
 		const auto color =
-		    localSounds.count(n) != 0
+		    shownKeys.test(n)
 		        ? ACTIVE_NOTE_COLOR
 		        : (n.isSharp()
 		               ? SHARP_NOTE_COLOR
@@ -362,10 +358,11 @@ void AppGraphics::updateKeys()
 	}
 }
 
-AppGraphics::AppGraphics()
+AppGraphics::AppGraphics() : m_held_keys()
 {
 	m_countdown_data.active = false;
 	m_midi_data.active = false;
+	m_midi_longest = 0.0f;
 }
 
 bool AppGraphics::begin(const char *window_title, unsigned w, unsigned h, unsigned countdown_begin, float yscale, AppData *app_data)
@@ -393,6 +390,7 @@ bool AppGraphics::begin(const char *window_title, unsigned w, unsigned h, unsign
 	m_resolution = {800, 600};
 
 	initShaders();
+	initNoteField();
 
 	initGraphics();
 	initPiano();
@@ -407,10 +405,10 @@ bool AppGraphics::begin(const char *window_title, unsigned w, unsigned h, unsign
 	return true;
 }
 
-void AppGraphics::beginCountdown()
+AppGraphics::time_point AppGraphics::beginCountdown()
 {
 	if (m_countdown_data.active || m_midi_data.active)
-		return;
+		return m_midi_data.playing_started;
 
 	const auto now = clock::now();
 
@@ -424,18 +422,45 @@ void AppGraphics::beginCountdown()
 
 	m_midi_data.active = true;
 	m_midi_data.playing_started = now + std::chrono::seconds(m_countdown_begin);
+
+	return m_midi_data.playing_started;
 }
 
-void AppGraphics::setNotes(const std::vector<MidiNote> &notes)
+void AppGraphics::setNotes(const SongTimeline &notes)
 {
-	m_midi_note_pairs.resize(notes.size());
-
-	int n = 0;
-	std::transform(
-	    notes.begin(), notes.end(), m_midi_note_pairs.begin(),
-	    [n, this](const MidiNote &info) {
-		    return std::make_pair(info, nullptr);
-	    });
+	const float width = m_maxkeywidth * NOTE_WIDTH_MULTIPLIER;
+
+	// Where each key's notes fall and their color, worked out once instead of per note
+	std::array<NoteField::Instance, 128> keys{};
+
+	for (Note n = STARTING_NOTE; n <= ENDING_NOTE; n = Note::fromMidi(n.toMidi() + 1)) {
+		auto &key = keys[n.toMidi()];
+
+		key.x = calculateNoteXPosition(n, m_maxkeywidth) + (n.isSharp() ? -width * 0.5f : 0.0f);
+		hueToColor(key.x + width * 0.5f - 0.3f, key.color);
+	}
+
+	std::vector<NoteField::Instance> instances(notes.size());
+
+	for (std::size_t i = 0; i < notes.size(); i++) {
+		instances[i] = keys[notes.keys[i]];
+		instances[i].begin = notes.begins[i];
+		instances[i].duration = notes.durations[i];
+	}
+
+	m_note_field.setInstances(instances);
+
+	m_midi_begins = notes.begins;
+	m_midi_reach.resize(notes.size());
+
+	float reach = 0.0f;
+	m_midi_longest = 0.0f;
+
+	for (std::size_t i = 0; i < notes.size(); i++) {
+		reach = std::max(reach, notes.end(i));
+		m_midi_reach[i] = reach;
+		m_midi_longest = std::max(m_midi_longest, notes.durations[i]);
+	}
 }
 
 void AppGraphics::loop()
@@ -447,6 +472,7 @@ void AppGraphics::end()
 {
 	m_countdown_manager = nullptr;
 	m_countdown_render = nullptr;
+	m_note_field.end();
 	m_midishader = nullptr;
 	m_keyshader = nullptr;
 
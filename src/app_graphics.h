@@ -2,7 +2,9 @@
 #define PIANO_APP_GRAPHICS_H
 
 #include "app_data.h"
+#include "note_field.h"
 #include "notes.h"
+#include "song_timeline.h"
 
 #include <neonBitmapText.h>
 #include <neonEngine.h>
@@ -30,12 +32,6 @@ public:
 	using clock = std::chrono::steady_clock;
 	using time_point = std::chrono::time_point<clock>;
 
-	struct MidiNote {
-		Note n;
-		float begin;
-		float duration;
-	};
-
 public:
 	std::function<void(unsigned, unsigned, Platform::ClickType, Platform::ClickDirection)> onClick;
 	Neon::EnginePtr neon;
@@ -45,7 +41,15 @@ private:
 	AppData *data;
 
 	std::unordered_map<Note, Neon::EngineObjectPtr> m_piano_keys;
-	std::vector<std::pair<MidiNote, Neon::EngineObjectPtr>> m_midi_note_pairs;
+	//! The start of each note of the song, in order, to find the visible window by a binary search
+	std::vector<float> m_midi_begins;
+	NoteField m_note_field;
+	//! The latest end among each note and the notes starting before it. It never
+	//! decreases, so a binary search skips the notes that ended before all earlier ones did.
+	std::vector<float> m_midi_reach;
+	//! No note starting more than this before now can still sound. One long note keeps
+	//! m_midi_reach up until it ends, so the window's lower edge is bounded by this too.
+	float m_midi_longest;
 
 	Neon::NodePtr m_piano_scene;
 	Neon::BitmapTextManagerComponentPtr m_countdown_manager;
@@ -53,6 +57,11 @@ private:
 
 	Calcda::Vector2 m_resolution;
 
+	//! The keys held down according to the note events seen so far
+	Sounds::Snapshot m_held_keys;
+	//! When the keys pressed since the last frame was submitted were read from the port
+	std::vector<NoteEvent::clock::time_point> m_undisplayed_presses;
+
 	unsigned m_countdown_begin;
 	float m_maxkeywidth;
 
@@ -79,12 +88,12 @@ private:
 	static float calculateNoteMaxWidth();
 	static float calculateNoteXPosition(Note note, float maxwidth);
 
-	Neon::EngineObjectPtr createMidiObject(Note note, float timestamp, float duration);
 	Neon::EngineObjectPtr createKeyObject(Note note, float x);
 
 	void initGraphics();
 	void mainLoop(Platform::Win32::PlatformContext *const context);
 	void initShaders();
+	void initNoteField();
 	void initPiano();
 	void initCountdown();
 
@@ -97,8 +106,9 @@ public:
 
 	bool begin(const char *window_title, unsigned w, unsigned h, unsigned countdown_begin, float yscale, AppData *data);
 
-	void beginCountdown();
-	void setNotes(const std::vector<MidiNote> &notes);
+	//! @returns when the song starts playing
+	time_point beginCountdown();
+	void setNotes(const SongTimeline &notes);
 
 	void loop();
 
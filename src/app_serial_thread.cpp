@@ -1,35 +1,186 @@
 #include "app_serial_thread.h"
 
+#include "recording_serial.h"
+#include "replay_serial.h"
+#include "serial_multiplexer.h"
 #include "serial_parser.h"
+
+#if defined(_WIN32)
 #include "windows_serial.h"
+#else
+#include "posix_serial.h"
+#endif
 
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
+
+namespace {
+struct SerialDevice {
+	SerialPortSpec spec;
+	KeyMap keymap;
+	std::unique_ptr<Serial> serial;
+	std::unique_ptr<SerialParser> parser;
+};
+
+using SerialDeviceList = std::vector<std::unique_ptr<SerialDevice>>;
+
+//! Picks the backend for a port and strips the port of any backend prefix
+std::unique_ptr<Serial> createSerial(const AppCommandLine &commandLine, std::string &port, std::size_t index)
+{
+	std::unique_ptr<Serial> result;
+
+	if (port.rfind(ReplaySerial::PORT_PREFIX, 0) == 0) {
+		port.erase(0, std::string(ReplaySerial::PORT_PREFIX).size());
+		result = std::make_unique<ReplaySerial>(commandLine.replaySpeed);
+	}
+	else {
+#if defined(_WIN32)
+		result = std::make_unique<WindowsSerial>();
+#else
+		result = std::make_unique<PosixSerial>();
+#endif
+	}
+
+	if (!commandLine.record.empty()) {
+		const auto path = commandLine.ports.size() > 1
+		                      ? commandLine.record + "." + std::to_string(index)
+		                      : commandLine.record;
+
+		result = std::make_unique<RecordingSerial>(std::move(result), path);
+	}
+
+	return result;
+}
+
+void printStatistics(const SerialDeviceList &devices, double seconds)
+{
+	std::cout << "Serial statistics over " << std::fixed << std::setprecision(1) << seconds << "s:\n";
+
+	for (const auto &device : devices) {
+		const auto &stats = device->parser->statistics();
+
+		std::cout << "\t" << device->spec.port << ": "
+		          << stats.bytes << " bytes (" << double(stats.bytes) / seconds << " B/s), "
+		          << stats.lines << " lines, "
+		          << stats.frames << " frames, "
+		          << stats.malformed << " malformed, "
+		          << stats.dropped << " dropped\n";
+	}
+
+	std::cout << std::defaultfloat << std::flush;
+}
+
+void closeDevices(SerialDeviceList &devices)
+{
+	for (auto &device : devices)
+		device->serial->end();
+
+	devices.clear();
+}
+} // namespace
+
+bool parsePortSpec(const std::string &spec, SerialPortSpec &result)
+{
+	result.port = spec;
+	result.offset = 0;
+
+	const auto separator = spec.rfind(':');
+	if (separator == std::string::npos || separator + 1 == spec.size())
+		return !spec.empty();
+
+	const auto suffix = spec.substr(separator + 1);
+	std::size_t parsed = 0;
+	int offset = 0;
+
+	try {
+		offset = std::stoi(suffix, &parsed);
+	}
+	catch (const std::exception &) {
+		return true;
+	}
+
+	if (parsed != suffix.size())
+		return true;
+
+	result.port = spec.substr(0, separator);
+	result.offset = offset;
+
+	return !result.port.empty();
+}
 
 void serial_thread(const AppCommandLine &commandLine, AppData *data)
 {
-	std::cout << "Trying to initialize serial on " << commandLine.port
-	          << " at " << commandLine.baud << "bps with the settings:\n"
-	          << "\tbyte size: " << commandLine.serialSettings.byte_size << "\n"
-	          << "\tparity:    " << commandLine.serialSettings.parity << "\n"
-	          << "\tstop bits: " << commandLine.serialSettings.stop_bits << std::endl;
+	SerialDeviceList devices;
+	SerialMultiplexer multiplexer;
+
+	const auto fail = [&]() {
+		closeDevices(devices);
 
-	WindowsSerial serial;
-	if (!serial.begin(commandLine.port, commandLine.baud, commandLine.serialSettings)) {
 		data->state = AppState::FINISHED;
 		data->condition_variables.serial_done.notify_one();
+	};
+
+	KeyMap keymap = DEFAULT_KEYMAP;
+	if (!commandLine.keymap.empty() && !keymap.loadFromFile(commandLine.keymap))
+		return fail();
 
-		return;
+	std::cout << "Trying to initialize serial at " << commandLine.baud << "bps with the settings:\n"
+	          << "\tbyte size: " << commandLine.serialSettings.byte_size << "\n"
+	          << "\tparity:    " << commandLine.serialSettings.parity << "\n"
+	          << "\tstop bits: " << commandLine.serialSettings.stop_bits << "\n"
+	          << "\tprotocol:  " << commandLine.protocol << std::endl;
+
+	for (const auto &port : commandLine.ports) {
+		auto device = std::make_unique<SerialDevice>();
+		parsePortSpec(port, device->spec);
+
+		std::string path = device->spec.port;
+		device->serial = createSerial(commandLine, path, devices.size());
+
+		std::cout << "Opening " << device->spec.port << " with a note offset of " << device->spec.offset << std::endl;
+
+		device->keymap = keymap;
+		if (!device->keymap.transpose(device->spec.offset)) {
+			std::cerr << "The offset of " << device->spec.port << " moves keys out of range." << std::endl;
+			return fail();
+		}
+
+		if (!device->serial->begin(path, commandLine.baud, commandLine.serialSettings)) {
+			std::cerr << "Couldn't open " << device->spec.port << "." << std::endl;
+			return fail();
+		}
+
+		device->parser = std::make_unique<SerialParser>(device->serial.get(), &(data->sounds), &(data->events), &(device->keymap), commandLine.protocol);
+
+		multiplexer.add(device->serial.get());
+		devices.push_back(std::move(device));
 	}
 
 	data->condition_variables.serial_done.notify_one();
 
-	SerialParser parser(&serial, &(data->sounds));
+	const auto report_interval = std::chrono::seconds(commandLine.serialReport);
+	const auto started = std::chrono::steady_clock::now();
+	auto last_report = started;
 
 	while (data->state != AppState::FINISHED) {
-		parser.update();
+		for (const auto index : multiplexer.wait())
+			devices[index]->parser->update();
+
+		if (report_interval.count() > 0) {
+			const auto now = std::chrono::steady_clock::now();
+
+			if (now - last_report >= report_interval) {
+				printStatistics(devices, std::chrono::duration<double>(now - started).count());
+				last_report = now;
+			}
+		}
 	}
 
-	serial.end();
+	printStatistics(devices, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+
+	closeDevices(devices);
 }
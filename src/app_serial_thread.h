@@ -3,6 +3,17 @@
 
 #include "app_data.h"
 
+#include <string>
+
+struct SerialPortSpec {
+	std::string port;
+	//! Semitones added to every note of the keymap for this port
+	int offset;
+};
+
+//! Splits a "PORT[:OFFSET]" command line argument, e.g. "COM4:-12"
+bool parsePortSpec(const std::string &spec, SerialPortSpec &result);
+
 void serial_thread(const AppCommandLine &commandLine, AppData *data);
 
 #endif // !defined(PIANO_APP_SERIAL_THREAD_H)
\ No newline at end of file
@@ -1,130 +1,113 @@
 #include "audio.h"
 
+#include "fluidsynth_backend.h"
+#include "null_backend.h"
+#include "openal_backend.h"
+#include "sample_instrument.h"
+#include "synth.h"
+#include "wav_backend.h"
+
+#include <algorithm>
 #include <cstdint>
-
-#define _USE_MATH_DEFINES
-#include <math.h>
+#include <iostream>
 
 #include <functional>
 
-namespace {
+/* static */ std::map<std::string, Audio::Playback> Audio::PLAYBACK_MAP = {
+#if PIANO_MIDI_ENABLED
+    {"midi", Audio::Playback::PLAYBACK_MIDI},
+#endif
 #if PIANO_AL_ENABLED
-constexpr static const size_t WAVE_RES = 11025;
-constexpr static const double BASE_FREQUENCY = 440.0;
-ALuint makeSineBuffer()
-{
-	ALuint buf = 0;
-	alGenBuffers(1, &buf);
-
-	std::int16_t sine_wave[WAVE_RES];
-	for (unsigned int i = 0; i < WAVE_RES; i++) {
-		sine_wave[i] = std::int16_t(sin((M_PI * 2.0 * BASE_FREQUENCY) / (double)WAVE_RES * (double)i) * 32760.0);
-	}
-
-	alBufferData(buf, AL_FORMAT_MONO16, sine_wave, sizeof(sine_wave), WAVE_RES);
+    {"square", Audio::Playback::PLAYBACK_SQUARE},
+    {"sine", Audio::Playback::PLAYBACK_SINE},
+    {"triangle", Audio::Playback::PLAYBACK_TRIANGLE},
+    {"samples", Audio::Playback::PLAYBACK_SAMPLES}
+#endif
+};
 
-	return buf;
-}
+/* static */ std::map<std::string, Audio::Output> Audio::OUTPUT_MAP = {
+    {"device", Audio::Output::OUTPUT_DEVICE},
+    {"null", Audio::Output::OUTPUT_NULL},
+    {"wav", Audio::Output::OUTPUT_WAV}
+};
 
-ALuint makeSquareBuffer()
+/* static */ std::unique_ptr<Instrument> Audio::makeInstrument(const Settings &settings)
 {
-	ALuint buf = 0;
-	alGenBuffers(1, &buf);
+	const auto kernel = settings.scalar_kernel ? OscillatorBank::scalarKernel().kernel : OscillatorBank::bestKernel().kernel;
 
-	std::int16_t square_wave[WAVE_RES];
-	for (unsigned int i = 0; i < WAVE_RES; i++) {
-		square_wave[i] = std::int16_t((((int(i) / int(BASE_FREQUENCY)) % 2) - 1) * 32760.0);
+	switch (settings.playback) {
+		case PLAYBACK_SQUARE:
+			return std::make_unique<Synth>(Wavetables::WAVEFORM_SQUARE, settings.polyphony, kernel);
+		case PLAYBACK_TRIANGLE:
+			return std::make_unique<Synth>(Wavetables::WAVEFORM_TRIANGLE, settings.polyphony, kernel);
+		case PLAYBACK_SAMPLES: {
+			auto samples = std::make_unique<SampleInstrument>(settings.polyphony);
+			if (!samples->load(settings.samples))
+				return nullptr;
+
+			std::cout << "Loaded " << samples->sampleCount() << " samples, " << samples->preloadedBytes() / 1024 << " KiB preloaded." << std::endl;
+			return samples;
+		}
+		default:
+			return std::make_unique<Synth>(Wavetables::WAVEFORM_SINE, settings.polyphony, kernel);
 	}
-
-	alBufferData(buf, AL_FORMAT_MONO16, square_wave, sizeof(square_wave), WAVE_RES);
-
-	return buf;
 }
 
-ALuint makeTriangleBuffer()
-{
-	ALuint buf = 0;
-	alGenBuffers(1, &buf);
-
-	std::int16_t triangle_wave[WAVE_RES];
-	for (unsigned int i = 0; i < WAVE_RES; i++) {
-		triangle_wave[i] = std::int16_t(((i % int(BASE_FREQUENCY)) - (int(BASE_FREQUENCY) / 2)) * 32760.0);
-	}
-
-	alBufferData(buf, AL_FORMAT_MONO16, triangle_wave, sizeof(triangle_wave), WAVE_RES);
+Audio::Audio() : backend(), instrument(nullptr), activeNotes(), playback(PLAYBACK_SINE), song(), song_next(0), song_ended(false), song_start() {}
 
-	return buf;
-}
-
-ALuint makeBufferedSource(ALuint buf, float pitch)
+bool Audio::begin(const Settings &settings)
 {
-	ALuint src = 0;
-	alGenSources(1, &src);
+	if (backend)
+		return false;
 
-	alSourcei(src, AL_BUFFER, buf);
-	alSourcei(src, AL_LOOPING, 1);
-	alSourcef(src, AL_PITCH, pitch);
+	playback = settings.playback;
 
-	return src;
-}
-#endif
-} // namespace
+	std::unique_ptr<Instrument> software;
 
-/* static */ std::map<std::string, Audio::Playback> Audio::PLAYBACK_MAP = {
-#if PIANO_MIDI_ENABLED
-    {"midi", Audio::Playback::PLAYBACK_MIDI},
-#endif
-#if PIANO_AL_ENABLED
-    {"square", Audio::Playback::PLAYBACK_SQUARE},
-    {"sine", Audio::Playback::PLAYBACK_SINE},
-    {"triangle", Audio::Playback::PLAYBACK_TRIANGLE}
-#endif
-};
+	// FluidSynth brings its own instrument
+	if (settings.output != OUTPUT_NULL && (settings.output == OUTPUT_WAV || playback != PLAYBACK_MIDI)) {
+		if (playback == PLAYBACK_MIDI)
+			std::cerr << "The soundfont can't be recorded, using the sine waveform." << std::endl;
 
-bool Audio::begin(Playback iplayback, std::string soundfont)
-{
-#if PIANO_AL_ENABLED
-	if (iplayback != PLAYBACK_MIDI) {
-		if (context != nullptr)
+		software = makeInstrument(settings);
+		if (!software)
 			return false;
-
-		device = alcOpenDevice(nullptr);
-		if (!device)
-			return false;
-
-		context = alcCreateContext(device, nullptr);
-		if (!context) {
-			alcCloseDevice(device);
-			return false;
-		}
-
-		alcMakeContextCurrent(context);
 	}
-#endif
 
-	playback = iplayback;
+	instrument = software.get();
 
-	switch (playback) {
-#if PIANO_AL_ENABLED
-		case PLAYBACK_SINE:
-			note_buffer = makeSineBuffer();
-			break;
-		case PLAYBACK_SQUARE:
-			note_buffer = makeSquareBuffer();
+	switch (settings.output) {
+		case OUTPUT_NULL:
+			backend = std::make_unique<NullBackend>();
 			break;
-		case PLAYBACK_TRIANGLE:
-			note_buffer = makeTriangleBuffer();
+		case OUTPUT_WAV:
+			backend = std::make_unique<WavBackend>(std::move(software), settings.file);
 			break;
-#endif
+		case OUTPUT_DEVICE:
 #if PIANO_MIDI_ENABLED
-		case PLAYBACK_MIDI:
-			settings = new_fluid_settings();
-
-			synth = new_fluid_synth(settings);
-			driver = new_fluid_audio_driver(settings, synth);
-			fluid_synth_sfload(synth, soundfont.c_str(), 1);
-			break;
+			if (playback == PLAYBACK_MIDI) {
+				backend = std::make_unique<FluidSynthBackend>(
+				    settings.soundfont, FluidSynthBackend::Tuning{settings.fluid_polyphony, settings.period_size, settings.periods, settings.cpu_cores});
+				break;
+			}
 #endif
+#if PIANO_AL_ENABLED
+			if (playback != PLAYBACK_MIDI)
+				backend = std::make_unique<OpenALBackend>(std::move(software), settings.latency_ms);
+#endif
+			break;
+	}
+
+	if (!backend) {
+		std::cerr << "Playback " << playback << " isn't available on output " << settings.output << "." << std::endl;
+		instrument = nullptr;
+		return false;
+	}
+
+	if (!backend->begin()) {
+		backend.reset();
+		instrument = nullptr;
+		return false;
 	}
 
 	return true;
@@ -132,52 +115,34 @@ bool Audio::begin(Playback iplayback, std::string soundfont)
 
 void Audio::end()
 {
-#if PIANO_AL_ENABLED
-	if (playback != PLAYBACK_MIDI) {
-		if (context == nullptr)
-			return;
-
-		for (const auto &activeNote : activeNotes) {
-			alSourceStop(activeNote.second);
-			alDeleteSources(1, &(activeNote.second));
-		}
-		activeNotes.clear();
-
-		alDeleteBuffers(1, &note_buffer);
-		note_buffer = 0;
-
-		alcMakeContextCurrent(nullptr);
-		alcDestroyContext(context);
-		alcCloseDevice(device);
+	if (!backend)
+		return;
+
+	backend->end();
+	backend.reset();
+	instrument = nullptr;
+	activeNotes.clear();
+	song.clear();
+	song_next = 0;
+	song_ended = false;
+}
 
-		context = nullptr;
-	}
-#endif
+bool Audio::send(const AudioCommand &command)
+{
+	// Nothing to send to if begin() failed
+	if (!backend)
+		return false;
 
-#if PIANO_MIDI_ENABLED
-	if (playback == PLAYBACK_MIDI) {
-		fluid_synth_all_notes_off(synth, 0);
+	if (backend->send(command))
+		return true;
 
-		delete_fluid_audio_driver(driver);
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
-	}
-#endif
+	std::cerr << "The audio thread is behind, dropped a command." << std::endl;
+	return false;
 }
 
 void Audio::setVolume(float volume)
 {
-#if PIANO_AL_ENABLED
-	if (playback != PLAYBACK_MIDI) {
-		alListenerf(AL_GAIN, volume);
-	}
-#endif
-
-#ifdef PIANO_MIDI_ENABLED
-	if (playback == PLAYBACK_MIDI) {
-		fluid_settings_setnum(settings, "synth.gain", (double)volume);
-	}
-#endif
+	send(AudioCommand{AudioCommand::COMMAND_VOLUME, Note(), volume, 0, {}});
 }
 
 std::unordered_set<Note> Audio::getActiveNotes() const
@@ -189,46 +154,30 @@ std::unordered_set<Note> Audio::getActiveNotes() const
 	return result;
 }
 
-void Audio::playNote(Note note)
+AudioBackend::State Audio::state() const
 {
-#if PIANO_MIDI_ENABLED
-	if (playback == Playback::PLAYBACK_MIDI) {
-		std::printf("Playing %d %d\n", note.key, note.octave);
-		fluid_synth_noteon(synth, 0, note.toMidi(), 80);
-		activeNotes[note] = 1;
-	}
-#endif
+	return backend ? backend->state() : AudioBackend::STATE_FAILED;
+}
 
-#if PIANO_AL_ENABLED
-	if (playback != PLAYBACK_MIDI) {
-		ALuint source = makeBufferedSource(note_buffer, note.toRelativePitch());
+void Audio::playNote(Note note)
+{
+	// Keys pressed before the backend can play are dropped instead of piling up
+	if (state() != AudioBackend::STATE_READY)
+		return;
 
-		alSourcePlay(source);
+	if (instrument != nullptr)
+		instrument->prefetch(note);
 
-		activeNotes[note] = source;
-	}
-#endif
+	send(AudioCommand{AudioCommand::COMMAND_NOTE_ON, note, 0.0f, 0, {}});
+	activeNotes[note] = 1;
 }
 
 void Audio::stopNote(Note note)
 {
-#if PIANO_MIDI_ENABLED
-	if (playback == Playback::PLAYBACK_MIDI) {
-		std::printf("Stopping %d %d\n", note.key, note.octave);
-		fluid_synth_noteoff(synth, 0, note.toMidi());
-		activeNotes.erase(note);
-	}
-#endif
+	if (activeNotes.erase(note) == 0)
+		return;
 
-#if PIANO_AL_ENABLED
-	if (playback != PLAYBACK_MIDI) {
-		const ALuint source = activeNotes[note];
-
-		alSourceStop(source);
-		alDeleteSources(1, &source);
-		activeNotes.erase(note);
-	}
-#endif
+	send(AudioCommand{AudioCommand::COMMAND_NOTE_OFF, note, 0.0f, 0, {}});
 }
 
 bool Audio::active() const
@@ -236,6 +185,60 @@ bool Audio::active() const
 	return !activeNotes.empty();
 }
 
+void Audio::playSong(std::vector<SongNote> notes, AudioCommand::clock::time_point start)
+{
+	if (!song.empty())
+		stopSong();
+
+	song = std::move(notes);
+	song_next = 0;
+	song_ended = false;
+	song_start = start;
+
+	send(AudioCommand{AudioCommand::COMMAND_SONG_START, Note(), 0.0f, 0, start});
+}
+
+void Audio::stopSong()
+{
+	song.clear();
+	song_next = 0;
+	song_ended = false;
+
+	send(AudioCommand{AudioCommand::COMMAND_SONG_STOP, Note(), 0.0f, 0, {}});
+}
+
+AudioCommand::clock::time_point Audio::updateSong(AudioCommand::clock::time_point now)
+{
+	const auto frameTime = [this](std::uint64_t frame) {
+		return song_start + std::chrono::duration_cast<AudioCommand::clock::duration>(
+		                        std::chrono::duration<double>(double(frame) / double(Instrument::SAMPLE_RATE)));
+	};
+
+	if (!backend)
+		return AudioCommand::clock::time_point::max();
+
+	// The render thread only holds a window of the song, so the queue can't fill up
+	for (; song_next < song.size() && frameTime(song[song_next].frame) < now + SONG_LOOKAHEAD; song_next++) {
+		const SongNote &note = song[song_next];
+		const auto type = note.on ? AudioCommand::COMMAND_SONG_NOTE_ON : AudioCommand::COMMAND_SONG_NOTE_OFF;
+
+		// Retried once the render thread has caught up
+		if (!backend->send(AudioCommand{type, note.note, 0.0f, note.frame, {}}))
+			return now + SONG_LOOKAHEAD / 4;
+	}
+
+	if (song_next == song.size()) {
+		// Lets the render thread stop streaming once the last note has played
+		if (!song.empty() && !song_ended && backend->send(AudioCommand{AudioCommand::COMMAND_SONG_END, Note(), 0.0f, 0, {}}))
+			song_ended = true;
+
+		return song_ended || song.empty() ? AudioCommand::clock::time_point::max() : now + SONG_LOOKAHEAD / 4;
+	}
+
+	// Half the lookahead early, so a late wakeup doesn't starve the render thread
+	return frameTime(song[song_next].frame) - SONG_LOOKAHEAD / 2;
+}
+
 std::ostream &operator<<(std::ostream &os, const Audio::Playback &par)
 {
 	for (const auto &entry : Audio::PLAYBACK_MAP) {
@@ -247,3 +250,15 @@ std::ostream &operator<<(std::ostream &os, const Audio::Playback &par)
 
 	return os;
 }
+
+std::ostream &operator<<(std::ostream &os, const Audio::Output &par)
+{
+	for (const auto &entry : Audio::OUTPUT_MAP) {
+		if (entry.second == par) {
+			os << entry.first;
+			break;
+		}
+	}
+
+	return os;
+}
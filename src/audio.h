@@ -1,61 +1,112 @@
 #ifndef PIANO_AUDIO_H
 #define PIANO_AUDIO_H
 
-#if PIANO_AL_ENABLED
-#include <AL.h>
-#include <ALC.h>
-#endif
-
 #include <chrono>
-#include <list>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "audio_backend.h"
+#include "instrument.h"
 #include "notes.h"
 
-#if PIANO_MIDI_ENABLED
-#include <fluidsynth.h>
-#endif
-
 class Audio {
 public:
 	constexpr static const std::size_t MIDI_BUFFER_COUNT = 3;
+	constexpr static const unsigned DEFAULT_POLYPHONY = 32;
+	constexpr static const unsigned MAX_POLYPHONY = 256;
+	//! Enough audio queued on the device to ride out the render thread being scheduled late
+	constexpr static const unsigned DEFAULT_LATENCY_MS = 30;
+
+	//! How far ahead of time song notes are handed to the render thread
+	constexpr static const auto SONG_LOOKAHEAD = std::chrono::milliseconds(200);
 
 	enum Playback : std::uint8_t {
 		PLAYBACK_SINE,
 		PLAYBACK_SQUARE,
 		PLAYBACK_TRIANGLE,
-		PLAYBACK_MIDI
+		PLAYBACK_MIDI,
+		PLAYBACK_SAMPLES
 	};
 
-protected:
-#if PIANO_AL_ENABLED
-	ALCcontext *context;
-	ALCdevice *device;
+	enum Output : std::uint8_t {
+		//! The sound card, through OpenAL or FluidSynth depending on the playback
+		OUTPUT_DEVICE,
+		//! Nothing is played
+		OUTPUT_NULL,
+		//! The software instruments are recorded to a WAV file
+		OUTPUT_WAV
+	};
 
-	ALuint note_buffer;
-#endif
+	struct Settings {
+		Playback playback;
+		std::string soundfont;
+		//! The directory of recordings played by PLAYBACK_SAMPLES
+		std::string samples;
+		//! The most notes the software instruments sound at once; pressing another stops the oldest
+		unsigned polyphony;
+		//! Synthesizes with the scalar kernel, so renders are the same on every CPU
+		bool scalar_kernel;
+		//! FluidSynth's voice limit, its driver period and period count, and its rendering
+		//! threads; 0 for the default. A soundfont note may take several voices.
+		unsigned fluid_polyphony;
+		unsigned period_size;
+		unsigned periods;
+		unsigned cpu_cores;
+		//! How much audio the software instruments keep queued on the device
+		unsigned latency_ms;
+		Output output;
+		//! The file written by OUTPUT_WAV
+		std::string file;
+	};
 
-#if PIANO_MIDI_ENABLED
-	fluid_synth_t *synth;
-	fluid_audio_driver_t *driver;
-	fluid_settings_t *settings;
-#endif
+	//! A note of an accompaniment, timed in frames of the output from the song's start
+	struct SongNote {
+		std::uint64_t frame;
+		Note note;
+		bool on;
+	};
+
+protected:
+	std::unique_ptr<AudioBackend> backend;
+	//! Owned by the backend; null when the backend has no software instrument
+	const Instrument *instrument;
 
 	std::unordered_map<Note, unsigned int> activeNotes;
 
 	Audio::Playback playback;
 
+	//! Sorted by frame; the notes before song_next were already sent
+	std::vector<SongNote> song;
+	std::size_t song_next;
+	//! Whether COMMAND_SONG_END went out after the last note
+	bool song_ended;
+	AudioCommand::clock::time_point song_start;
+
+	bool send(const AudioCommand &command);
+
 public:
 	static std::map<std::string, Playback> PLAYBACK_MAP;
+	static std::map<std::string, Output> OUTPUT_MAP;
+
+	//! The software instrument of a playback, or nullptr if it couldn't be loaded.
+	//! The soundfont falls back to the sine waveform.
+	static std::unique_ptr<Instrument> makeInstrument(const Settings &settings);
 
 public:
-	bool begin(Audio::Playback playback, std::string soundfont);
+	Audio();
+
+	//! With the soundfont the backend may still be loading when this returns
+	bool begin(const Settings &settings);
 	void end();
 
+	AudioBackend::State state() const;
+
 	void setVolume(float volume);
 
 	std::unordered_set<Note> getActiveNotes() const;
@@ -63,8 +114,19 @@ public:
 	void stopNote(Note note);
 
 	bool active() const;
+
+	//! Plays the notes along with the keyboard, the first frame at start. A song
+	//! already playing is stopped first. The notes have to be in order of their frame,
+	//! releases before presses on the same frame, so the caller sorts them off this thread.
+	void playSong(std::vector<SongNote> notes, AudioCommand::clock::time_point start);
+	//! Silences the song's notes and drops the ones not played yet
+	void stopSong();
+	//! Sends the song notes that fall within the lookahead
+	//! @returns when it has to be called again
+	AudioCommand::clock::time_point updateSong(AudioCommand::clock::time_point now);
 };
 
 std::ostream &operator<<(std::ostream &o, const Audio::Playback &p);
+std::ostream &operator<<(std::ostream &o, const Audio::Output &p);
 
-#endif // !defined(PIANO_AUDIO_H)
\ No newline at end of file
+#endif // !defined(PIANO_AUDIO_H)
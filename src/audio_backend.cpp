@@ -0,0 +1,51 @@
+#include "audio_backend.h"
+
+AudioBackend::AudioBackend() : m_song_notes(), m_rendered(0), m_song_start(0), m_song_playing(false), m_song_ended(false), m_song_sounding(), m_commands() {}
+
+AudioBackend::~AudioBackend() {}
+
+/* static */ void AudioBackend::apply(Instrument &instrument, float &volume, const AudioCommand &command)
+{
+	switch (command.type) {
+		case AudioCommand::COMMAND_NOTE_ON:
+			instrument.noteOn(command.note);
+			break;
+		case AudioCommand::COMMAND_NOTE_OFF:
+			instrument.noteOff(command.note);
+			break;
+		case AudioCommand::COMMAND_ALL_NOTES_OFF:
+			instrument.allNotesOff();
+			break;
+		case AudioCommand::COMMAND_VOLUME:
+			volume = command.volume;
+			break;
+		default:
+			break;
+	}
+}
+
+void AudioBackend::applyCommands(Instrument &instrument, float &volume)
+{
+	takeCommands([&instrument, &volume](const AudioCommand &command) { apply(instrument, volume, command); });
+}
+
+void AudioBackend::renderBlock(Instrument &instrument, float volume, float *out, std::size_t frames)
+{
+	renderSequenced(
+	    frames,
+	    [&instrument, &volume](const AudioCommand &command) { apply(instrument, volume, command); },
+	    [&instrument, out](std::size_t offset, std::size_t count) { instrument.render(out + offset, count); });
+
+	for (std::size_t i = 0; i < frames; i++)
+		out[i] = std::min(1.0f, std::max(-1.0f, out[i] * volume));
+}
+
+bool AudioBackend::send(const AudioCommand &command)
+{
+	if (!m_commands.push(command))
+		return false;
+
+	commandQueued();
+
+	return true;
+}
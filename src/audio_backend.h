@@ -0,0 +1,205 @@
+#ifndef PIANO_AUDIO_BACKEND_H
+#define PIANO_AUDIO_BACKEND_H
+
+#include "instrument.h"
+#include "notes.h"
+#include "spsc_queue.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+//! A change queued by the control thread for the thread that renders audio
+struct AudioCommand {
+	using clock = std::chrono::steady_clock;
+
+	enum Type : std::uint8_t {
+		COMMAND_NOTE_ON,
+		COMMAND_NOTE_OFF,
+		COMMAND_ALL_NOTES_OFF,
+		COMMAND_VOLUME,
+		//! The song's frame 0 sounds at time; earlier song notes are dropped
+		COMMAND_SONG_START,
+		COMMAND_SONG_STOP,
+		//! Every note of the song has been sent; it's over once they've played
+		COMMAND_SONG_END,
+		//! Played on the given frame of the song
+		COMMAND_SONG_NOTE_ON,
+		COMMAND_SONG_NOTE_OFF
+	};
+
+	Type type;
+	Note note;
+	float volume;
+	std::uint64_t frame;
+	clock::time_point time;
+};
+
+//! Where notes become sound. Commands reach the render thread through a wait-free
+//! queue, so rendering never waits on a lock or allocates to take them.
+//!
+//! Song notes are sent ahead of time and wait in the render thread until their frame
+//! comes up, which may be in the middle of a block: the block is rendered in pieces
+//! split at those frames.
+class AudioBackend {
+public:
+	constexpr static const std::size_t COMMAND_QUEUE_SIZE = 1024;
+	constexpr static const std::size_t NUM_KEYS = 128;
+
+	enum State : std::uint8_t {
+		//! Commands are taken, but nothing sounds yet
+		STATE_LOADING,
+		STATE_READY,
+		STATE_FAILED
+	};
+
+private:
+	//! Only used by the render thread
+	SpscQueue<AudioCommand, COMMAND_QUEUE_SIZE> m_song_notes;
+	std::uint64_t m_rendered;
+	std::uint64_t m_song_start;
+	bool m_song_playing;
+	bool m_song_ended;
+	std::bitset<NUM_KEYS> m_song_sounding;
+
+	template <typename Apply>
+	void playSongNote(const AudioCommand &command, Apply &apply)
+	{
+		const bool on = command.type == AudioCommand::COMMAND_SONG_NOTE_ON;
+
+		m_song_sounding.set(command.note.toMidi() % NUM_KEYS, on);
+		apply(AudioCommand{on ? AudioCommand::COMMAND_NOTE_ON : AudioCommand::COMMAND_NOTE_OFF, command.note, 0.0f, 0, {}});
+	}
+
+	template <typename Apply>
+	void stopSong(Apply &apply)
+	{
+		AudioCommand command;
+		while (m_song_notes.pop(command)) {}
+
+		for (std::size_t key = 0; key < NUM_KEYS; key++) {
+			if (m_song_sounding.test(key))
+				apply(AudioCommand{AudioCommand::COMMAND_NOTE_OFF, Note::fromMidi(std::uint8_t(key)), 0.0f, 0, {}});
+		}
+
+		m_song_sounding.reset();
+		m_song_playing = false;
+		m_song_ended = false;
+	}
+
+protected:
+	SpscQueue<AudioCommand, COMMAND_QUEUE_SIZE> m_commands;
+
+	//! Called on the control thread after queueing a command, to wake a sleeping render thread
+	virtual void commandQueued() {}
+
+	//! Frames already rendered that haven't been heard yet; only called from the render thread
+	virtual std::size_t queuedFrames() const { return 0; }
+
+	//! Whether song notes are still to be played. The song is timed in rendered frames,
+	//! so a backend that only renders while the instrument sounds must keep rendering
+	//! silence until then; only called from the render thread.
+	inline bool songPending() const { return m_song_playing && (!m_song_ended || !m_song_notes.empty()); }
+
+	//! Takes the queued commands on the render thread. Notes, volume and the like go to
+	//! apply() right away; song notes are kept for renderSequenced().
+	template <typename Apply>
+	void takeCommands(Apply apply)
+	{
+		const auto now = AudioCommand::clock::now();
+		AudioCommand command;
+
+		while (m_commands.pop(command)) {
+			switch (command.type) {
+				case AudioCommand::COMMAND_SONG_START: {
+					stopSong(apply);
+
+					// Counted from the next frame to be heard, not the next one rendered
+					const double delay = std::chrono::duration<double>(command.time - now).count() * double(Instrument::SAMPLE_RATE);
+					const std::uint64_t frames = std::uint64_t(std::max(0.0, delay));
+
+					m_song_start = m_rendered + (frames > queuedFrames() ? frames - queuedFrames() : 0);
+					m_song_playing = true;
+					break;
+				}
+				case AudioCommand::COMMAND_SONG_STOP:
+					stopSong(apply);
+					break;
+				case AudioCommand::COMMAND_SONG_END:
+					m_song_ended = m_song_playing;
+					break;
+				case AudioCommand::COMMAND_SONG_NOTE_ON:
+				case AudioCommand::COMMAND_SONG_NOTE_OFF:
+					// The control thread keeps the lookahead short enough to fit; if it
+					// didn't, the note plays early rather than getting lost
+					if (m_song_playing && !m_song_notes.push(command))
+						playSongNote(command, apply);
+					break;
+				default:
+					apply(command);
+					break;
+			}
+		}
+	}
+
+	//! Renders the next frames in pieces split where song notes fall. Song notes go to
+	//! apply() on their frame, and render(offset, count) fills the frames in between.
+	template <typename Apply, typename Render>
+	void renderSequenced(std::size_t frames, Apply apply, Render render)
+	{
+		std::size_t done = 0;
+
+		while (done < frames) {
+			std::size_t count = frames - done;
+			AudioCommand command;
+
+			while (m_song_notes.peek(command)) {
+				const std::uint64_t due = m_song_start + command.frame;
+				const std::uint64_t now = m_rendered + done;
+
+				if (due > now) {
+					count = std::size_t(std::min<std::uint64_t>(count, due - now));
+					break;
+				}
+
+				m_song_notes.pop(command);
+				playSongNote(command, apply);
+			}
+
+			render(done, count);
+			done += count;
+		}
+
+		m_rendered += frames;
+	}
+
+	//! takeCommands() for a software instrument
+	void applyCommands(Instrument &instrument, float &volume);
+
+	//! renderSequenced() for a software instrument, at the given volume and clamped to [-1, 1]
+	void renderBlock(Instrument &instrument, float volume, float *out, std::size_t frames);
+
+	static void apply(Instrument &instrument, float &volume, const AudioCommand &command);
+
+public:
+	AudioBackend();
+	virtual ~AudioBackend();
+
+	AudioBackend(const AudioBackend &) = delete;
+	AudioBackend &operator=(const AudioBackend &) = delete;
+
+	virtual bool begin() = 0;
+	//! Stops rendering; queued commands are dropped
+	virtual void end() = 0;
+
+	//! Safe to call from any thread
+	virtual State state() const { return STATE_READY; }
+
+	//! Only called from the one control thread
+	//! @returns false if the render thread is too far behind to take the command
+	bool send(const AudioCommand &command);
+};
+
+#endif // !defined(PIANO_AUDIO_BACKEND_H)
@@ -0,0 +1,34 @@
+#ifndef PIANO_BITS_H
+#define PIANO_BITS_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//! The index of the lowest set bit; value must not be 0
+inline unsigned lowestBit(std::uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+//! The index of the highest set bit; value must not be 0
+inline unsigned highestBit(std::uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+#endif // !defined(PIANO_BITS_H)
\ No newline at end of file
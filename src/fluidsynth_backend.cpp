@@ -0,0 +1,165 @@
+#include "fluidsynth_backend.h"
+
+#if PIANO_MIDI_ENABLED
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+FluidSynthBackend::FluidSynthBackend(std::string soundfont, const Tuning &tuning)
+    : AudioBackend(), m_soundfont(std::move(soundfont)), m_tuning(tuning), m_settings(nullptr), m_synth(nullptr), m_driver(nullptr),
+      m_state(STATE_FAILED), m_loader(), m_driver_frames(0) {}
+
+FluidSynthBackend::~FluidSynthBackend()
+{
+	end();
+}
+
+void FluidSynthBackend::setTuning(const char *name, unsigned value)
+{
+	if (value != 0 && fluid_settings_setint(m_settings, name, int(value)) == FLUID_FAILED)
+		std::cerr << "FluidSynth doesn't accept " << value << " for " << name << ", using the default." << std::endl;
+}
+
+bool FluidSynthBackend::begin()
+{
+	if (m_settings != nullptr)
+		return false;
+
+	if (!fluid_is_soundfont(m_soundfont.c_str())) {
+		std::cerr << m_soundfont << " isn't a soundfont." << std::endl;
+		return false;
+	}
+
+	m_settings = new_fluid_settings();
+
+	setTuning("synth.polyphony", m_tuning.polyphony);
+	setTuning("synth.cpu-cores", m_tuning.cpu_cores);
+	setTuning("audio.period-size", m_tuning.period_size);
+	setTuning("audio.periods", m_tuning.periods);
+
+	// Song notes are timed in frames at the rate of the software instruments
+	fluid_settings_setnum(m_settings, "synth.sample-rate", double(Instrument::SAMPLE_RATE));
+
+	// Read back, so FluidSynth's defaults are accounted for too
+	int period_size = 0;
+	int periods = 0;
+	fluid_settings_getint(m_settings, "audio.period-size", &period_size);
+	fluid_settings_getint(m_settings, "audio.periods", &periods);
+	m_driver_frames = std::size_t(std::max(0, period_size)) * std::size_t(std::max(0, periods));
+
+	// Only one thread calls into the synth at a time: the loader, then the driver
+	fluid_settings_setint(m_settings, "synth.threadsafe-api", 0);
+
+	m_synth = new_fluid_synth(m_settings);
+
+	m_state = STATE_LOADING;
+	m_loader = std::thread(&FluidSynthBackend::load, this);
+
+	return true;
+}
+
+void FluidSynthBackend::load()
+{
+	const auto begin = std::chrono::steady_clock::now();
+
+	if (fluid_synth_sfload(m_synth, m_soundfont.c_str(), 1) == FLUID_FAILED) {
+		std::cerr << "Couldn't load the soundfont " << m_soundfont << "." << std::endl;
+		m_state = STATE_FAILED;
+		return;
+	}
+
+	// Keys pressed while loading would all sound at once, so only their releases are kept
+	takeCommands([this](const AudioCommand &command) {
+		if (command.type != AudioCommand::COMMAND_NOTE_ON)
+			play(command);
+	});
+
+	// The driver's thread takes over the synth and the command queue from here
+	m_driver = new_fluid_audio_driver2(m_settings, &FluidSynthBackend::process, this);
+
+	if (m_driver == nullptr) {
+		std::cerr << "Couldn't start the FluidSynth audio driver." << std::endl;
+		m_state = STATE_FAILED;
+		return;
+	}
+
+	std::cout << "Loaded " << m_soundfont << " in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() << " s." << std::endl;
+
+	m_state = STATE_READY;
+}
+
+void FluidSynthBackend::end()
+{
+	// A soundfont being loaded can't be interrupted
+	if (m_loader.joinable())
+		m_loader.join();
+
+	// Stops the callback before the synth goes away
+	if (m_driver != nullptr)
+		delete_fluid_audio_driver(m_driver);
+
+	if (m_synth != nullptr)
+		delete_fluid_synth(m_synth);
+
+	if (m_settings != nullptr)
+		delete_fluid_settings(m_settings);
+
+	m_driver = nullptr;
+	m_synth = nullptr;
+	m_settings = nullptr;
+	m_state = STATE_FAILED;
+}
+
+void FluidSynthBackend::play(const AudioCommand &command)
+{
+	switch (command.type) {
+		case AudioCommand::COMMAND_NOTE_ON:
+			fluid_synth_noteon(m_synth, 0, command.note.toMidi(), NOTE_VELOCITY);
+			break;
+		case AudioCommand::COMMAND_NOTE_OFF:
+			fluid_synth_noteoff(m_synth, 0, command.note.toMidi());
+			break;
+		case AudioCommand::COMMAND_ALL_NOTES_OFF:
+			fluid_synth_all_notes_off(m_synth, -1);
+			break;
+		case AudioCommand::COMMAND_VOLUME:
+			fluid_synth_set_gain(m_synth, command.volume);
+			break;
+		default:
+			break;
+	}
+}
+
+/* static */ int FluidSynthBackend::process(void *data, int len, int nfx, float *fx[], int nout, float *out[])
+{
+	auto *backend = static_cast<FluidSynthBackend *>(data);
+
+	// Drivers without effect buffers get reverb and chorus mixed into the dry output
+	if (fx == nullptr) {
+		nfx = nout;
+		fx = out;
+	}
+
+	if (nfx > MAX_BUFFERS || nout > MAX_BUFFERS)
+		return FLUID_FAILED;
+
+	const auto play = [backend](const AudioCommand &command) { backend->play(command); };
+	int result = FLUID_OK;
+
+	backend->takeCommands(play);
+	backend->renderSequenced(std::size_t(len), play, [&](std::size_t offset, std::size_t count) {
+		float *fx_part[MAX_BUFFERS];
+		float *out_part[MAX_BUFFERS];
+
+		for (int i = 0; i < nfx; i++)
+			fx_part[i] = fx[i] + offset;
+		for (int i = 0; i < nout; i++)
+			out_part[i] = out[i] + offset;
+
+		if (fluid_synth_process(backend->m_synth, int(count), nfx, fx_part, nout, out_part) != FLUID_OK)
+			result = FLUID_FAILED;
+	});
+
+	return result;
+}
+#endif
@@ -0,0 +1,71 @@
+#ifndef PIANO_FLUIDSYNTH_BACKEND_H
+#define PIANO_FLUIDSYNTH_BACKEND_H
+
+#if PIANO_MIDI_ENABLED
+#include <fluidsynth.h>
+
+#include "audio_backend.h"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+//! Plays a soundfont through FluidSynth's audio driver. The driver's callback applies
+//! the queued commands before rendering, so the synth is only used from that thread.
+//!
+//! The soundfont is loaded on a thread of its own, which starts the driver once it's
+//! done; state() tells when the backend is ready to play.
+class FluidSynthBackend : public AudioBackend {
+public:
+	constexpr static const int NOTE_VELOCITY = 80;
+	//! The most driver buffers a block can be split across at song notes
+	constexpr static const int MAX_BUFFERS = 16;
+
+	//! FluidSynth's engine settings; 0 keeps FluidSynth's default
+	struct Tuning {
+		//! Voices, not notes: a note of a layered preset takes one per layer
+		unsigned polyphony;
+		//! Frames per driver callback
+		unsigned period_size;
+		//! Driver buffers in flight; with period_size sets the output latency
+		unsigned periods;
+		//! Threads rendering voices in parallel
+		unsigned cpu_cores;
+	};
+
+private:
+	std::string m_soundfont;
+	Tuning m_tuning;
+
+	fluid_settings_t *m_settings;
+	fluid_synth_t *m_synth;
+	fluid_audio_driver_t *m_driver;
+
+	std::atomic<State> m_state;
+	std::thread m_loader;
+	//! The driver's buffers in frames, which are rendered before they're heard
+	std::size_t m_driver_frames;
+
+	static int process(void *data, int len, int nfx, float *fx[], int nout, float *out[]);
+	void play(const AudioCommand &command);
+
+	void setTuning(const char *name, unsigned value);
+	void load();
+
+protected:
+	std::size_t queuedFrames() const override { return m_driver_frames; }
+
+public:
+	FluidSynthBackend(std::string soundfont, const Tuning &tuning);
+	~FluidSynthBackend() override;
+
+	//! Only fails right away if the soundfont isn't one; loading errors show in state()
+	bool begin() override;
+	void end() override;
+
+	State state() const override { return m_state; }
+};
+#endif
+
+#endif // !defined(PIANO_FLUIDSYNTH_BACKEND_H)
@@ -0,0 +1,32 @@
+#ifndef PIANO_INSTRUMENT_H
+#define PIANO_INSTRUMENT_H
+
+#include "notes.h"
+
+#include <cstddef>
+
+//! Something that renders notes into a mono stream a block at a time. Only the render
+//! thread calls it, except for prefetch().
+class Instrument {
+public:
+	constexpr static const unsigned SAMPLE_RATE = 48000;
+	constexpr static const std::size_t BLOCK_SIZE = 128;
+
+	virtual ~Instrument() {}
+
+	virtual void noteOn(Note note) = 0;
+	virtual void noteOff(Note note) = 0;
+	virtual void allNotesOff() = 0;
+
+	//! Mixes the next frames into out, which is overwritten
+	virtual void render(float *out, std::size_t frames) = 0;
+
+	//! True while any voice, held or releasing, makes a sound
+	virtual bool active() const = 0;
+
+	//! Called on the control thread before a note is sent to the render thread,
+	//! to start reading whatever the note will need
+	virtual void prefetch(Note) const {}
+};
+
+#endif // !defined(PIANO_INSTRUMENT_H)
@@ -0,0 +1,86 @@
+#include "latency.h"
+
+#include "bits.h"
+
+#include <algorithm>
+#include <iomanip>
+
+/* static */ const std::array<const char *, LatencyTrace::NUM_STAGES> LatencyTrace::STAGE_NAMES = {
+    "decode",
+    "sounds",
+    "audio",
+    "display"};
+
+LatencyHistogram::LatencyHistogram() : m_buckets(), m_count(0), m_max(0)
+{
+	for (auto &bucket : m_buckets)
+		bucket = 0;
+}
+
+/* static */ std::size_t LatencyHistogram::bucket(std::uint64_t ns)
+{
+	if (ns < (std::uint64_t(1) << MIN_EXPONENT))
+		return 0;
+
+	const unsigned exponent = highestBit(ns);
+	const std::size_t sub_bucket = (ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+	return std::min<std::size_t>((exponent - MIN_EXPONENT) * SUB_BUCKETS + sub_bucket, NUM_BUCKETS - 1);
+}
+
+/* static */ std::uint64_t LatencyHistogram::bucketLimit(std::size_t index)
+{
+	const unsigned exponent = MIN_EXPONENT + unsigned(index / SUB_BUCKETS);
+	const std::uint64_t sub_bucket = index % SUB_BUCKETS;
+
+	return ((SUB_BUCKETS + sub_bucket + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+	const std::uint64_t ns = duration.count() > 0 ? std::uint64_t(duration.count()) : 0;
+
+	m_buckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+
+	std::uint64_t max = m_max.load(std::memory_order_relaxed);
+	while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double ratio) const
+{
+	const std::uint64_t total = count();
+	if (total == 0)
+		return std::chrono::nanoseconds(0);
+
+	const std::uint64_t rank = std::max<std::uint64_t>(1, std::uint64_t(ratio * double(total) + 0.5));
+	std::uint64_t seen = 0;
+
+	for (std::size_t i = 0; i < NUM_BUCKETS; i++) {
+		seen += m_buckets[i].load(std::memory_order_relaxed);
+
+		if (seen >= rank)
+			return std::min(std::chrono::nanoseconds(bucketLimit(i)), max());
+	}
+
+	return max();
+}
+
+void LatencyTrace::print(std::ostream &os) const
+{
+	const auto micros = [](std::chrono::nanoseconds ns) { return double(ns.count()) / 1000.0; };
+
+	os << "Key latency since serial arrival (us):" << std::endl;
+
+	for (std::size_t i = 0; i < NUM_STAGES; i++) {
+		const auto &histogram = m_stages[i];
+
+		os << "  " << std::left << std::setw(8) << STAGE_NAMES[i] << std::right
+		   << " n=" << std::setw(8) << histogram.count()
+		   << std::fixed << std::setprecision(1)
+		   << " p50=" << std::setw(9) << micros(histogram.percentile(0.5))
+		   << " p99=" << std::setw(9) << micros(histogram.percentile(0.99))
+		   << " max=" << std::setw(9) << micros(histogram.max())
+		   << std::defaultfloat << std::endl;
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef PIANO_LATENCY_H
+#define PIANO_LATENCY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+//! Counts durations in buckets four to an octave, from about a microsecond to a minute.
+//! Recording is two relaxed atomic adds and, rarely, a compare-exchange for the maximum.
+class LatencyHistogram {
+public:
+	constexpr static const unsigned SUB_BUCKET_BITS = 2;
+	constexpr static const unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+	//! Durations up to 2^MIN_EXPONENT ns share the first bucket
+	constexpr static const unsigned MIN_EXPONENT = 10;
+	constexpr static const unsigned MAX_EXPONENT = 36;
+	constexpr static const std::size_t NUM_BUCKETS = (MAX_EXPONENT - MIN_EXPONENT) * SUB_BUCKETS;
+
+private:
+	std::array<std::atomic<std::uint64_t>, NUM_BUCKETS> m_buckets;
+	std::atomic<std::uint64_t> m_count;
+	std::atomic<std::uint64_t> m_max;
+
+	static std::size_t bucket(std::uint64_t ns);
+	//! The longest duration that falls into a bucket
+	static std::uint64_t bucketLimit(std::size_t index);
+
+public:
+	LatencyHistogram();
+
+	void record(std::chrono::nanoseconds duration);
+
+	inline std::uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+	inline std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed)); }
+
+	//! An upper bound for the given ratio of the recorded durations, in [0-1]
+	std::chrono::nanoseconds percentile(double ratio) const;
+};
+
+//! Where the time between a key changing and the user noticing goes. Every stage
+//! is measured from when the key's bytes were read from the serial port.
+class LatencyTrace {
+public:
+	enum Stage : std::uint8_t {
+		//! The parser finished the line or frame
+		STAGE_DECODE,
+		//! Sounds holds the new state
+		STAGE_SOUNDS,
+		//! Audio::playNote was called
+		STAGE_AUDIO,
+		//! The first frame showing a pressed key was submitted; releases aren't measured
+		STAGE_DISPLAY,
+		NUM_STAGES
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	static const std::array<const char *, NUM_STAGES> STAGE_NAMES;
+
+private:
+	std::array<LatencyHistogram, NUM_STAGES> m_stages;
+
+public:
+	inline void record(Stage stage, clock::time_point arrived, clock::time_point reached)
+	{
+		m_stages[stage].record(reached - arrived);
+	}
+
+	inline const LatencyHistogram &stage(Stage stage) const { return m_stages[stage]; }
+
+	void print(std::ostream &os) const;
+};
+
+#endif // !defined(PIANO_LATENCY_H)
\ No newline at end of file
@@ -2,8 +2,6 @@
 
 #include "app.h"
 
-#include <MidiFile.h>
-
 int main(int argc, char *argv[])
 {
 	PianoApp app;
@@ -12,6 +10,17 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	if (!app.arguments.render.empty()) {
+		if (!app.render()) {
+			std::cerr << "Failed rendering " << app.arguments.render << "." << std::endl;
+			return 5;
+		}
+
+		return 0;
+	}
+
+	app.loadSong();
+
 	if (!app.initAudio()) {
 		app.cleanup();
 		std::cerr << "Failed initializing OpenAL." << std::endl;
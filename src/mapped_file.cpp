@@ -0,0 +1,161 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr) {}
+#else
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(-1) {}
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::open(const std::string &path)
+{
+	close();
+
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		std::cerr << "Couldn't open " << path << "." << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+		std::cerr << "Couldn't map the empty file " << path << "." << std::endl;
+		close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = static_cast<const std::uint8_t *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr) {
+		std::cerr << "Couldn't map " << path << "." << std::endl;
+		close();
+		return false;
+	}
+
+	m_size = std::size_t(size.QuadPart);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::advise(std::size_t, std::size_t, Advice) const
+{
+	// The Windows memory manager already reads ahead on mapped views
+}
+#else
+bool MappedFile::open(const std::string &path)
+{
+	close();
+
+	m_file = ::open(path.c_str(), O_RDONLY);
+	if (m_file < 0) {
+		std::cerr << "Couldn't open " << path << "." << std::endl;
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(m_file, &status) != 0 || status.st_size == 0) {
+		std::cerr << "Couldn't map the empty file " << path << "." << std::endl;
+		close();
+		return false;
+	}
+
+	void *data = mmap(nullptr, std::size_t(status.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED) {
+		std::cerr << "Couldn't map " << path << "." << std::endl;
+		close();
+		return false;
+	}
+
+	m_data = static_cast<const std::uint8_t *>(data);
+	m_size = std::size_t(status.st_size);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<std::uint8_t *>(m_data), m_size);
+
+	if (m_file >= 0)
+		::close(m_file);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_file = -1;
+}
+
+void MappedFile::advise(std::size_t offset, std::size_t length, Advice advice) const
+{
+	if (m_data == nullptr || offset >= m_size)
+		return;
+
+	static const std::size_t page_size = std::size_t(sysconf(_SC_PAGESIZE));
+
+	std::size_t begin = offset;
+	std::size_t end = std::min(m_size, offset + length);
+
+	if (advice == ADVICE_DONT_NEED) {
+		// Keeps the pages shared with the neighbouring ranges
+		begin = (begin + page_size - 1) / page_size * page_size;
+		end = end / page_size * page_size;
+	}
+	else {
+		begin = begin / page_size * page_size;
+	}
+
+	if (begin >= end)
+		return;
+
+	int flag = MADV_NORMAL;
+	switch (advice) {
+		case ADVICE_WILL_NEED:
+			flag = MADV_WILLNEED;
+			break;
+		case ADVICE_DONT_NEED:
+			flag = MADV_DONTNEED;
+			break;
+		case ADVICE_SEQUENTIAL:
+			flag = MADV_SEQUENTIAL;
+			break;
+	}
+
+	madvise(const_cast<std::uint8_t *>(m_data) + begin, end - begin, flag);
+}
+#endif
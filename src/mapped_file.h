@@ -0,0 +1,51 @@
+#ifndef PIANO_MAPPED_FILE_H
+#define PIANO_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//! A read-only view of a whole file through the page cache. Pages are only read
+//! from disk when they're touched, or ahead of time through advise().
+class MappedFile {
+public:
+	enum Advice : std::uint8_t {
+		//! Start reading the range now, the kernel doesn't wait for a page fault
+		ADVICE_WILL_NEED,
+		//! The range is no longer needed in this process; it may stay in the page cache
+		ADVICE_DONT_NEED,
+		//! The file is read front to back, so aggressive read-ahead pays off
+		ADVICE_SEQUENTIAL
+	};
+
+private:
+	const std::uint8_t *m_data;
+	std::size_t m_size;
+
+#if defined(_WIN32)
+	void *m_file;
+	void *m_mapping;
+#else
+	int m_file;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool open(const std::string &path);
+	void close();
+
+	//! A hint only; ranges are widened to whole pages, except for ADVICE_DONT_NEED,
+	//! which only drops the pages entirely inside the range
+	void advise(std::size_t offset, std::size_t length, Advice advice) const;
+
+	inline const std::uint8_t *data() const { return m_data; }
+	inline std::size_t size() const { return m_size; }
+	inline bool isOpen() const { return m_data != nullptr; }
+};
+
+#endif // !defined(PIANO_MAPPED_FILE_H)
@@ -0,0 +1,378 @@
+#include "midi_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <thread>
+
+namespace {
+constexpr static const std::size_t CHUNK_HEADER_SIZE = 8;
+constexpr static const std::size_t HEADER_SIZE = 6;
+//! Marks a held note that's left out, so its note-off still has something to pop
+constexpr static const std::size_t SKIPPED = std::numeric_limits<std::size_t>::max();
+
+constexpr static const std::uint8_t STATUS_NOTE_OFF = 0x80;
+constexpr static const std::uint8_t STATUS_NOTE_ON = 0x90;
+constexpr static const std::uint8_t STATUS_SYSEX = 0xF0;
+constexpr static const std::uint8_t STATUS_SYSEX_ESCAPE = 0xF7;
+constexpr static const std::uint8_t STATUS_META = 0xFF;
+
+constexpr static const std::uint8_t META_END_OF_TRACK = 0x2F;
+constexpr static const std::uint8_t META_TEMPO = 0x51;
+
+std::uint32_t readBigEndian(const std::uint8_t *data, unsigned bytes)
+{
+	std::uint32_t value = 0;
+
+	for (unsigned i = 0; i < bytes; i++)
+		value = (value << 8) | data[i];
+
+	return value;
+}
+
+//! @returns false if the number runs past the end
+bool readVariableLength(const std::uint8_t *&data, const std::uint8_t *end, std::uint32_t &value)
+{
+	value = 0;
+
+	// At most four bytes of seven bits each
+	for (unsigned i = 0; i < 4; i++) {
+		if (data >= end)
+			return false;
+
+		const std::uint8_t byte = *data++;
+		value = (value << 7) | (byte & 0x7F);
+
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+//! Combines tracks whose notes are each in order of their start into a single timeline
+//! in that order. Notes starting together keep the order of their tracks.
+void merge(std::vector<SongTimeline> &tracks, SongTimeline &timeline)
+{
+	struct Head {
+		float begin;
+		std::size_t track;
+
+		bool operator>(const Head &other) const { return begin != other.begin ? begin > other.begin : track > other.track; }
+	};
+
+	std::size_t total = 0;
+	std::size_t nonempty = 0;
+
+	for (const auto &track : tracks) {
+		total += track.size();
+		nonempty += track.empty() ? 0 : 1;
+	}
+
+	if (nonempty <= 1) {
+		for (auto &track : tracks) {
+			if (!track.empty())
+				timeline = std::move(track);
+		}
+
+		return;
+	}
+
+	std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+	std::vector<std::size_t> positions(tracks.size(), 0);
+
+	for (std::size_t i = 0; i < tracks.size(); i++) {
+		if (!tracks[i].empty())
+			heads.push(Head{tracks[i].begins[0], i});
+	}
+
+	timeline.resize(total);
+
+	for (std::size_t out = 0; !heads.empty(); out++) {
+		const std::size_t i = heads.top().track;
+		heads.pop();
+
+		const auto &track = tracks[i];
+		const std::size_t in = positions[i]++;
+
+		timeline.keys[out] = track.keys[in];
+		timeline.tracks[out] = track.tracks[in];
+		timeline.begins[out] = track.begins[in];
+		timeline.durations[out] = track.durations[in];
+
+		if (positions[i] < track.size())
+			heads.push(Head{track.begins[positions[i]], i});
+	}
+}
+} // namespace
+
+MidiReader::MidiReader(const Settings &settings) : m_settings(settings), m_format(0), m_division(0), m_skipped(0) {}
+
+double MidiReader::secondsPerTick(std::uint32_t tempo) const
+{
+	// SMPTE time: the high byte is minus the frames per second, the low byte the ticks per frame
+	if (m_division & 0x8000) {
+		const int fps = -int(std::int8_t(m_division >> 8));
+		const double rate = fps == 29 ? 29.97 : double(fps);
+
+		return 1.0 / (rate * double(m_division & 0xFF));
+	}
+
+	return double(tempo) * 1e-6 / double(m_division);
+}
+
+bool MidiReader::readHeader(const std::uint8_t *data, std::size_t size, std::vector<Chunk> &tracks)
+{
+	if (size < CHUNK_HEADER_SIZE + HEADER_SIZE || std::memcmp(data, "MThd", 4) != 0) {
+		std::cerr << "Not a standard midi file." << std::endl;
+		return false;
+	}
+
+	const std::size_t header_size = readBigEndian(data + 4, 4);
+	if (header_size < HEADER_SIZE || header_size > size - CHUNK_HEADER_SIZE) {
+		std::cerr << "The midi file's header is invalid." << std::endl;
+		return false;
+	}
+
+	m_format = std::uint16_t(readBigEndian(data + 8, 2));
+	m_division = std::uint16_t(readBigEndian(data + 12, 2));
+
+	if (m_format > 2 || (m_division & 0x7FFF) == 0 || ((m_division & 0x8000) && (m_division & 0xFF) == 0)) {
+		std::cerr << "Unsupported midi format " << m_format << " or time division " << m_division << "." << std::endl;
+		return false;
+	}
+
+	tracks.clear();
+
+	// Unknown chunks are skipped, a truncated last one is read as far as it goes
+	for (std::size_t offset = CHUNK_HEADER_SIZE + header_size; size - offset >= CHUNK_HEADER_SIZE;) {
+		const std::size_t length = std::min<std::size_t>(readBigEndian(data + offset + 4, 4), size - offset - CHUNK_HEADER_SIZE);
+
+		if (std::memcmp(data + offset, "MTrk", 4) == 0)
+			tracks.push_back(Chunk{data + offset + CHUNK_HEADER_SIZE, length});
+
+		offset += CHUNK_HEADER_SIZE + length;
+	}
+
+	if (tracks.size() > std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1) {
+		std::cerr << "The midi file has too many tracks." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool MidiReader::readTrack(const Chunk &chunk, std::uint16_t track, std::vector<TempoChange> &tempo, bool owns_tempo, SongTimeline &timeline, std::size_t &skipped) const
+{
+	const std::uint8_t *data = chunk.data;
+	const std::uint8_t *const end = chunk.data + chunk.size;
+
+	std::uint64_t tick = 0;
+	std::uint8_t running_status = 0;
+	std::size_t tempo_index = 0;
+
+	// The notes sounding on each channel and key, the latest on top
+	std::vector<std::vector<std::size_t>> held(NUM_CHANNELS * NUM_KEYS);
+
+	// Ticks only move forward within a track, and so does the tempo map
+	const auto secondsAt = [&tempo, &tempo_index](std::uint64_t at) {
+		while (tempo_index + 1 < tempo.size() && tempo[tempo_index + 1].tick <= at)
+			tempo_index++;
+
+		const auto &change = tempo[tempo_index];
+		return change.seconds + double(at - change.tick) * change.seconds_per_tick;
+	};
+
+	const auto release = [&timeline](std::vector<std::size_t> &stack, double seconds) {
+		if (stack.empty())
+			return;
+
+		const std::size_t index = stack.back();
+		stack.pop_back();
+
+		if (index != SKIPPED)
+			timeline.durations[index] = float(seconds - double(timeline.begins[index]));
+	};
+
+	// A cut off track keeps the notes read so far, and ends at the last whole event
+	const auto truncated = [track, &tick](std::uint64_t whole) {
+		std::cerr << "Track " << track << " of the midi file is truncated, it's read as far as it goes." << std::endl;
+		tick = whole;
+	};
+
+	while (data < end) {
+		std::uint32_t delta;
+		if (!readVariableLength(data, end, delta) || data >= end) {
+			truncated(tick);
+			break;
+		}
+
+		const std::uint64_t previous = tick;
+		tick += delta;
+
+		std::uint8_t status = *data;
+
+		if (status & 0x80) {
+			data++;
+		}
+		else if (running_status) {
+			status = running_status;
+		}
+		else {
+			std::cerr << "Track " << track << " of the midi file has data without a status." << std::endl;
+			return false;
+		}
+
+		if (status < STATUS_SYSEX) {
+			// Program change and channel pressure have one data byte, the others two
+			const std::size_t length = (status & 0xE0) == 0xC0 ? 1 : 2;
+			if (std::size_t(end - data) < length) {
+				truncated(previous);
+				break;
+			}
+
+			running_status = status;
+
+			const std::uint8_t type = status & 0xF0;
+			const std::uint8_t key = data[0] & 0x7F;
+			auto &stack = held[(status & 0x0F) * NUM_KEYS + key];
+
+			if (type == STATUS_NOTE_ON && (data[1] & 0x7F) > 0) {
+				const int transposed = int(key) + m_settings.transpose;
+
+				if (transposed < m_settings.lowest.toMidi() || transposed > m_settings.highest.toMidi()) {
+					stack.push_back(SKIPPED);
+					skipped++;
+				}
+				else {
+					stack.push_back(timeline.push(std::uint8_t(transposed), track, float(secondsAt(tick)), 0.0f));
+				}
+			}
+			else if (type == STATUS_NOTE_ON || type == STATUS_NOTE_OFF) {
+				release(stack, secondsAt(tick));
+			}
+
+			data += length;
+		}
+		else if (status == STATUS_META) {
+			running_status = 0;
+
+			std::uint32_t length;
+			if (data >= end) {
+				truncated(previous);
+				break;
+			}
+
+			const std::uint8_t type = *data++;
+			if (!readVariableLength(data, end, length) || std::size_t(end - data) < length) {
+				truncated(previous);
+				break;
+			}
+
+			if (type == META_END_OF_TRACK)
+				break;
+
+			if (type == META_TEMPO && length == 3 && owns_tempo && !(m_division & 0x8000)) {
+				const double seconds_per_tick = secondsPerTick(readBigEndian(data, 3));
+
+				if (tempo.back().tick == tick)
+					tempo.back().seconds_per_tick = seconds_per_tick;
+				else
+					tempo.push_back(TempoChange{tick, secondsAt(tick), seconds_per_tick});
+			}
+
+			data += length;
+		}
+		else if (status == STATUS_SYSEX || status == STATUS_SYSEX_ESCAPE) {
+			running_status = 0;
+
+			std::uint32_t length;
+			if (!readVariableLength(data, end, length) || std::size_t(end - data) < length) {
+				truncated(previous);
+				break;
+			}
+
+			data += length;
+		}
+		else {
+			std::cerr << "Track " << track << " of the midi file has the unexpected status " << unsigned(status) << "." << std::endl;
+			return false;
+		}
+	}
+
+	// Notes still held when the track ends are released there
+	const double last = secondsAt(tick);
+
+	for (auto &stack : held) {
+		while (!stack.empty())
+			release(stack, last);
+	}
+
+	return true;
+}
+
+bool MidiReader::read(const std::uint8_t *data, std::size_t size, SongTimeline &timeline)
+{
+	m_skipped = 0;
+	timeline.clear();
+
+	std::vector<Chunk> tracks;
+	if (!readHeader(data, size, tracks))
+		return false;
+
+	const TempoChange initial{0, 0.0, secondsPerTick(DEFAULT_TEMPO)};
+
+	// Format 2 tracks are separate songs, each with its own tempo. Otherwise the first
+	// track holds the tempo map, so it's read before the others.
+	const bool independent = m_format == 2;
+	std::vector<TempoChange> conductor{initial};
+
+	std::vector<SongTimeline> decoded(tracks.size());
+	std::vector<std::size_t> skipped(tracks.size(), 0);
+	// Not std::vector<bool>, whose elements can't be written from several threads
+	std::vector<std::uint8_t> succeeded(tracks.size(), 1);
+
+	std::size_t first = 0;
+
+	if (!independent && !tracks.empty()) {
+		if (!readTrack(tracks[0], 0, conductor, true, decoded[0], skipped[0]))
+			return false;
+
+		first = 1;
+	}
+
+	// The tracks don't depend on each other, so they're handed out to the workers one at a time
+	std::atomic_size_t next(first);
+
+	const auto decode = [&]() {
+		for (std::size_t i = next++; i < tracks.size(); i = next++) {
+			std::vector<TempoChange> tempo = independent ? std::vector<TempoChange>{initial} : conductor;
+			succeeded[i] = readTrack(tracks[i], std::uint16_t(i), tempo, independent, decoded[i], skipped[i]);
+		}
+	};
+
+	const std::size_t workers = std::min<std::size_t>(tracks.size() - first, std::max(1u, std::thread::hardware_concurrency()));
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < workers; i++)
+		threads.emplace_back(decode);
+
+	decode();
+
+	for (auto &thread : threads)
+		thread.join();
+
+	if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end())
+		return false;
+
+	for (const auto count : skipped)
+		m_skipped += count;
+
+	merge(decoded, timeline);
+
+	return true;
+}
@@ -0,0 +1,70 @@
+#ifndef PIANO_MIDI_READER_H
+#define PIANO_MIDI_READER_H
+
+#include "notes.h"
+#include "song_timeline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Reads the notes of a standard midi file straight out of memory, usually a mapped
+//! file, in one pass over each track. Note-ons are paired with their note-offs through
+//! a stack per channel and key, and ticks are turned into seconds as they're read, so
+//! nothing but the notes themselves is ever stored. The tracks are decoded on as many
+//! threads as there are cores and merged in order of their start.
+//!
+//! Tempo changes are taken from the first track, which is where format 1 files keep
+//! them; tracks of format 2 files each have their own.
+class MidiReader {
+public:
+	struct Settings {
+		int transpose;
+		//! Notes outside the range are left out
+		Note lowest;
+		Note highest;
+	};
+
+	constexpr static const std::uint32_t DEFAULT_TEMPO = 500000;
+	constexpr static const unsigned NUM_CHANNELS = 16;
+	constexpr static const unsigned NUM_KEYS = 128;
+
+private:
+	struct Chunk {
+		const std::uint8_t *data;
+		std::size_t size;
+	};
+
+	//! Where the tempo changes, and the time in seconds it happens at
+	struct TempoChange {
+		std::uint64_t tick;
+		double seconds;
+		double seconds_per_tick;
+	};
+
+	Settings m_settings;
+	std::uint16_t m_format;
+	std::uint16_t m_division;
+	std::size_t m_skipped;
+
+	//! The duration of a tick at the given tempo in microseconds per quarter note
+	double secondsPerTick(std::uint32_t tempo) const;
+
+	bool readHeader(const std::uint8_t *data, std::size_t size, std::vector<Chunk> &tracks);
+
+	//! Appends the notes of a track in the order they start. Tempo changes are added to
+	//! the map if the track owns it, and ignored otherwise. A truncated track ends at its
+	//! last whole event. Safe to call concurrently.
+	bool readTrack(const Chunk &chunk, std::uint16_t track, std::vector<TempoChange> &tempo, bool owns_tempo, SongTimeline &timeline, std::size_t &skipped) const;
+
+public:
+	explicit MidiReader(const Settings &settings);
+
+	//! Replaces the timeline with the notes of the file, in order of their start
+	bool read(const std::uint8_t *data, std::size_t size, SongTimeline &timeline);
+
+	//! The notes left out of the last read for being out of range
+	inline std::size_t skipped() const { return m_skipped; }
+};
+
+#endif // !defined(PIANO_MIDI_READER_H)
@@ -0,0 +1,71 @@
+#ifndef PIANO_NOTE_EVENTS_H
+#define PIANO_NOTE_EVENTS_H
+
+#include "notes.h"
+#include "spsc_queue.h"
+#include "wakeup.h"
+
+#include <atomic>
+#include <chrono>
+
+struct NoteEvent {
+	using clock = std::chrono::steady_clock;
+
+	//! When the bytes carrying the change were read from the port
+	clock::time_point time;
+	//! When the parser had decoded the change and when Sounds held it, for latency tracing
+	clock::time_point decoded;
+	clock::time_point applied;
+	Note note;
+	bool on;
+};
+
+//! Note changes in the order the keyboard reported them, for one consumer thread
+struct NoteEventChannel {
+	constexpr static const std::size_t QUEUE_SIZE = 1024;
+
+	SpscQueue<NoteEvent, QUEUE_SIZE> queue;
+
+	//! Set when an event didn't fit; the consumer should fall back to the Sounds state
+	std::atomic_bool overflowed;
+
+private:
+	Wakeup m_wakeup;
+
+	bool ready() const { return !queue.empty() || overflowed; }
+
+public:
+	NoteEventChannel() : queue(), overflowed(false), m_wakeup() {}
+
+	//! Blocks the consumer until there are events to handle or the deadline passes
+	void waitUntil(NoteEvent::clock::time_point deadline)
+	{
+		m_wakeup.waitUntil(deadline, [this] { return ready(); });
+	}
+
+	//! Called by the producer after pushing events, or to wake the consumer for any other reason
+	void notify() { m_wakeup.notify(); }
+};
+
+//! Hands every note change from the serial thread to each consumer
+struct NoteEventQueues {
+	NoteEventChannel audio;
+	NoteEventChannel graphics;
+
+	//! Only called from the serial thread; consumers aren't woken until notify()
+	void publish(const NoteEvent &event)
+	{
+		for (auto *channel : {&audio, &graphics}) {
+			if (!channel->queue.push(event))
+				channel->overflowed = true;
+		}
+	}
+
+	void notify()
+	{
+		audio.notify();
+		graphics.notify();
+	}
+};
+
+#endif // !defined(PIANO_NOTE_EVENTS_H)
\ No newline at end of file
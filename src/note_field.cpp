@@ -0,0 +1,126 @@
+#include "note_field.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+constexpr static const GLuint ATTRIB_POSITION = 0;
+constexpr static const GLuint ATTRIB_X = 1;
+constexpr static const GLuint ATTRIB_BEGIN = 2;
+constexpr static const GLuint ATTRIB_DURATION = 3;
+constexpr static const GLuint ATTRIB_COLOR = 4;
+
+//! The corners of a unit quad, drawn as a triangle strip
+constexpr static const float QUAD[] = {
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+    1.0f, 1.0f};
+} // namespace
+
+NoteField::NoteField()
+    : m_shader(), m_time_uniform(), m_vertex_array(0), m_quad_buffer(0), m_instance_buffer(0),
+      m_instance_count(0), m_first(0), m_count(0), m_time(0.0f) {}
+
+void NoteField::begin(Neon::ShaderComponentPtr shader)
+{
+	m_shader = shader;
+	m_time_uniform = m_shader->getNodeByPath<Neon::UniformComponent>("$u_time");
+
+	GLint previous_buffer = 0;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous_buffer);
+
+	glGenVertexArrays(1, &m_vertex_array);
+	glGenBuffers(1, &m_quad_buffer);
+	glGenBuffers(1, &m_instance_buffer);
+
+	glBindVertexArray(m_vertex_array);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_quad_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(QUAD), QUAD, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(ATTRIB_POSITION);
+	glVertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+	// The pointers into the instance buffer are set by draw(), from the first note drawn
+	glBindBuffer(GL_ARRAY_BUFFER, m_instance_buffer);
+
+	for (const GLuint attrib : {ATTRIB_X, ATTRIB_BEGIN, ATTRIB_DURATION, ATTRIB_COLOR}) {
+		glEnableVertexAttribArray(attrib);
+		glVertexAttribDivisor(attrib, 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, GLuint(previous_buffer));
+}
+
+void NoteField::end()
+{
+	if (m_vertex_array != 0) {
+		glDeleteBuffers(1, &m_instance_buffer);
+		glDeleteBuffers(1, &m_quad_buffer);
+		glDeleteVertexArrays(1, &m_vertex_array);
+	}
+
+	m_vertex_array = 0;
+	m_quad_buffer = 0;
+	m_instance_buffer = 0;
+	m_instance_count = 0;
+	m_count = 0;
+
+	m_time_uniform = nullptr;
+	m_shader = nullptr;
+}
+
+void NoteField::setInstances(const std::vector<Instance> &instances)
+{
+	GLint previous_buffer = 0;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous_buffer);
+
+	// The song doesn't change while it plays, so it's uploaded once for the whole game
+	glBindBuffer(GL_ARRAY_BUFFER, m_instance_buffer);
+	glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(instances.size() * sizeof(Instance)), instances.empty() ? nullptr : instances.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, GLuint(previous_buffer));
+
+	m_instance_count = instances.size();
+	m_first = 0;
+	m_count = 0;
+}
+
+void NoteField::setWindow(std::size_t first, std::size_t count, float time)
+{
+	m_first = std::min(first, m_instance_count);
+	m_count = std::min(count, m_instance_count - m_first);
+	m_time = time;
+}
+
+void NoteField::draw() const
+{
+	if (m_count == 0 || m_shader == nullptr)
+		return;
+
+	GLint previous_array = 0;
+	GLint previous_buffer = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous_array);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous_buffer);
+
+	m_shader->use();
+	m_time_uniform->upload(m_time);
+
+	glBindVertexArray(m_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instance_buffer);
+
+	// GL 3.3 has no base instance, so the window is chosen by where the attributes start
+	const auto offset = [this](std::size_t field) {
+		return reinterpret_cast<const void *>(m_first * sizeof(Instance) + field);
+	};
+
+	glVertexAttribPointer(ATTRIB_X, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), offset(offsetof(Instance, x)));
+	glVertexAttribPointer(ATTRIB_BEGIN, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), offset(offsetof(Instance, begin)));
+	glVertexAttribPointer(ATTRIB_DURATION, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), offset(offsetof(Instance, duration)));
+	glVertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), offset(offsetof(Instance, color)));
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(m_count));
+
+	glBindVertexArray(GLuint(previous_array));
+	glBindBuffer(GL_ARRAY_BUFFER, GLuint(previous_buffer));
+}
@@ -0,0 +1,56 @@
+#ifndef PIANO_NOTE_FIELD_H
+#define PIANO_NOTE_FIELD_H
+
+#include <neonComponent.h>
+#include <neonEngine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Draws every falling note of the song with a single instanced draw call. The notes
+//! are uploaded once, one instance each, and the vertex shader places them from the
+//! current time, so a frame only costs a uniform and the range of instances to draw.
+class NoteField {
+public:
+	//! The per-note data, laid out as the vertex shader reads it
+	struct Instance {
+		//! The left edge of the note
+		float x;
+		float begin;
+		float duration;
+		std::uint8_t color[4];
+	};
+
+	static_assert(sizeof(Instance) == 16, "The instances must not have padding.");
+
+private:
+	Neon::ShaderComponentPtr m_shader;
+	Neon::UniformComponentPtr m_time_uniform;
+
+	GLuint m_vertex_array;
+	GLuint m_quad_buffer;
+	GLuint m_instance_buffer;
+
+	std::size_t m_instance_count;
+	std::size_t m_first;
+	std::size_t m_count;
+	float m_time;
+
+public:
+	NoteField();
+
+	//! Creates the buffers; the shader has to have a u_time uniform
+	void begin(Neon::ShaderComponentPtr shader);
+	void end();
+
+	//! Replaces the notes, which have to be in order of their start
+	void setInstances(const std::vector<Instance> &instances);
+
+	//! Only the given range of instances is drawn
+	void setWindow(std::size_t first, std::size_t count, float time);
+
+	void draw() const;
+};
+
+#endif // !defined(PIANO_NOTE_FIELD_H)
@@ -1,5 +1,6 @@
 #include "notes.h"
 
+#include <cctype>
 #include <cmath>
 
 constexpr static const char *KEY_STRING_MAP[] = {
@@ -39,4 +40,34 @@ std::ostream &operator<<(std::ostream &o, const Note &note)
 {
 	o << note.key << int(note.octave);
 	return o;
+}
+
+std::istream &operator>>(std::istream &i, Note &note)
+{
+	char letter = 0;
+	if (!(i >> letter))
+		return i;
+
+	static constexpr const std::uint8_t LETTER_KEYS[] = {Note::A, Note::B, Note::C, Note::D, Note::E, Note::F, Note::G};
+
+	letter = char(std::toupper(static_cast<unsigned char>(letter)));
+	if (letter < 'A' || letter > 'G') {
+		i.setstate(std::ios::failbit);
+		return i;
+	}
+
+	std::uint8_t key = LETTER_KEYS[letter - 'A'];
+	if (i.peek() == '#') {
+		i.get();
+		key++;
+	}
+
+	unsigned int octave = 0;
+	if (!(i >> octave) || key > Note::B) {
+		i.setstate(std::ios::failbit);
+		return i;
+	}
+
+	note = Note{Note::Key(key), std::uint8_t(octave)};
+	return i;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define PIANO_NOTES_H
 
 #include <cstdint>
+#include <istream>
 #include <ostream>
 
 struct Note {
@@ -33,6 +34,9 @@ struct Note {
 std::ostream &operator<<(std::ostream &o, const Note::Key &key);
 std::ostream &operator<<(std::ostream &o, const Note &note);
 
+//! Reads a note in the form written by operator<<, e.g. "C#4"
+std::istream &operator>>(std::istream &i, Note &note);
+
 template <>
 struct std::hash<Note> {
 	constexpr std::size_t operator()(const Note &note) const noexcept
@@ -0,0 +1,22 @@
+#ifndef PIANO_NULL_BACKEND_H
+#define PIANO_NULL_BACKEND_H
+
+#include "audio_backend.h"
+
+//! Takes every command and plays nothing, so the rest of the pipeline can be measured
+//! without an audio device
+class NullBackend : public AudioBackend {
+protected:
+	//! There's no render thread, so the commands are dropped as soon as they're queued
+	void commandQueued() override
+	{
+		AudioCommand command;
+		while (m_commands.pop(command)) {}
+	}
+
+public:
+	bool begin() override { return true; }
+	void end() override {}
+};
+
+#endif // !defined(PIANO_NULL_BACKEND_H)
@@ -0,0 +1,75 @@
+#include "offline_renderer.h"
+
+#include "wav_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+OfflineRenderer::OfflineRenderer(std::unique_ptr<Instrument> instrument, float volume)
+    : m_instrument(std::move(instrument)), m_volume(volume), m_events(), m_statistics() {}
+
+void OfflineRenderer::addNote(Note note, double begin, double duration)
+{
+	const auto toFrame = [](double seconds) { return std::uint64_t(std::llround(std::max(0.0, seconds) * double(Instrument::SAMPLE_RATE))); };
+
+	const std::uint64_t on = toFrame(begin);
+
+	// Every note sounds for at least a frame, so its release can't be sorted before its press
+	m_events.push_back(Event{on, note, true});
+	m_events.push_back(Event{std::max(on + 1, toFrame(begin + duration)), note, false});
+}
+
+bool OfflineRenderer::render(const std::string &path)
+{
+	// A note released on the frame another one starts is released first
+	std::stable_sort(m_events.begin(), m_events.end(), [](const Event &a, const Event &b) {
+		return a.frame != b.frame ? a.frame < b.frame : (!a.on && b.on);
+	});
+
+	WavWriter writer;
+	if (!writer.open(path, Instrument::SAMPLE_RATE, 1))
+		return false;
+
+	std::array<float, Instrument::BLOCK_SIZE> block;
+	std::uint64_t frame = 0;
+	auto event = m_events.begin();
+
+	const auto begin = std::chrono::steady_clock::now();
+
+	while (event != m_events.end() || m_instrument->active()) {
+		const std::uint64_t block_end = frame + block.size();
+		std::size_t filled = 0;
+
+		// Split the block wherever an event falls inside it
+		while (filled < block.size()) {
+			for (; event != m_events.end() && event->frame <= frame + filled; ++event) {
+				if (event->on)
+					m_instrument->noteOn(event->note);
+				else
+					m_instrument->noteOff(event->note);
+			}
+
+			const std::uint64_t until = event != m_events.end() ? std::min(event->frame, block_end) : block_end;
+			const std::size_t count = std::size_t(until - (frame + filled));
+
+			m_instrument->render(block.data() + filled, count);
+			filled += count;
+		}
+
+		for (auto &sample : block)
+			sample *= m_volume;
+
+		writer.write(block.data(), block.size());
+		frame = block_end;
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+
+	m_statistics.frames = frame;
+	m_statistics.audio_seconds = double(frame) / double(Instrument::SAMPLE_RATE);
+	m_statistics.wall_seconds = std::chrono::duration<double>(end - begin).count();
+
+	return writer.close();
+}
@@ -0,0 +1,49 @@
+#ifndef PIANO_OFFLINE_RENDERER_H
+#define PIANO_OFFLINE_RENDERER_H
+
+#include "instrument.h"
+#include "notes.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! Plays notes through an instrument into a WAV file as fast as the CPU allows,
+//! without an audio device. Notes start and stop on the exact frame.
+class OfflineRenderer {
+public:
+	struct Statistics {
+		std::uint64_t frames;
+		double audio_seconds;
+		double wall_seconds;
+
+		inline double realTimeFactor() const { return wall_seconds > 0.0 ? audio_seconds / wall_seconds : 0.0; }
+	};
+
+private:
+	struct Event {
+		std::uint64_t frame;
+		Note note;
+		bool on;
+	};
+
+	std::unique_ptr<Instrument> m_instrument;
+	float m_volume;
+
+	std::vector<Event> m_events;
+	Statistics m_statistics;
+
+public:
+	OfflineRenderer(std::unique_ptr<Instrument> instrument, float volume);
+
+	//! @param begin when the note starts in seconds
+	void addNote(Note note, double begin, double duration);
+
+	//! Renders every note until the last one has faded out
+	bool render(const std::string &path);
+
+	inline const Statistics &statistics() const { return m_statistics; }
+};
+
+#endif // !defined(PIANO_OFFLINE_RENDERER_H)
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "openal_backend.h"
+
+#if PIANO_AL_ENABLED
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+//! The longest the idle render thread sleeps without a command, to notice end()
+constexpr static const auto IDLE_INTERVAL = std::chrono::milliseconds(100);
+
+// AL_SOFT_events, declared here since not every OpenAL ships OpenAL Soft's alext.h
+constexpr static const ALenum EVENT_TYPE_BUFFER_COMPLETED = 0x19A4;
+
+using EventProc = void (*)(ALenum type, ALuint object, ALuint param, ALsizei length, const char *message, void *user);
+using EventControlProc = void (*)(ALsizei count, const ALenum *types, ALboolean enable);
+using EventCallbackProc = void (*)(EventProc callback, void *user);
+} // namespace
+
+/* static */ std::size_t OpenALBackend::bufferCount(unsigned latency_ms)
+{
+	const std::size_t frames = std::size_t(latency_ms) * Instrument::SAMPLE_RATE / 1000;
+
+	return std::max(MIN_STREAM_BUFFERS, (frames + Instrument::BLOCK_SIZE - 1) / Instrument::BLOCK_SIZE);
+}
+
+OpenALBackend::OpenALBackend(std::unique_ptr<Instrument> instrument, unsigned latency_ms)
+    : AudioBackend(), m_device(nullptr), m_context(nullptr), m_source(0), m_buffers(bufferCount(latency_ms), 0),
+      m_instrument(std::move(instrument)), m_volume(1.0f), m_free_buffers(m_buffers.size(), 0), m_free_count(0),
+      m_buffer_played(false), m_buffer_events(false), m_mix_block(), m_sample_block(),
+      m_running(false), m_wakeup(), m_thread() {}
+
+OpenALBackend::~OpenALBackend()
+{
+	end();
+}
+
+bool OpenALBackend::begin()
+{
+	if (m_context != nullptr)
+		return false;
+
+	m_device = alcOpenDevice(nullptr);
+	if (!m_device)
+		return false;
+
+	m_context = alcCreateContext(m_device, nullptr);
+	if (!m_context) {
+		alcCloseDevice(m_device);
+		m_device = nullptr;
+		return false;
+	}
+
+	alcMakeContextCurrent(m_context);
+
+	// Whatever was created is released again, the context and the device included
+	const auto fail = [this]() {
+		std::cerr << "Couldn't create the audio stream." << std::endl;
+
+		alcMakeContextCurrent(nullptr);
+		alcDestroyContext(m_context);
+		alcCloseDevice(m_device);
+
+		m_context = nullptr;
+		m_device = nullptr;
+		m_source = 0;
+
+		return false;
+	};
+
+	alGetError();
+	alGenSources(1, &m_source);
+	if (alGetError() != AL_NO_ERROR)
+		return fail();
+
+	alGenBuffers(ALsizei(m_buffers.size()), m_buffers.data());
+	if (alGetError() != AL_NO_ERROR) {
+		alDeleteSources(1, &m_source);
+		return fail();
+	}
+
+	m_free_buffers = m_buffers;
+	m_free_count = m_buffers.size();
+
+	m_buffer_events = enableBufferEvents();
+
+	m_running = true;
+	m_thread = std::thread(&OpenALBackend::renderThread, this);
+
+	return true;
+}
+
+void OpenALBackend::end()
+{
+	if (m_context == nullptr)
+		return;
+
+	if (m_thread.joinable()) {
+		m_running = false;
+		m_wakeup.notify();
+		m_thread.join();
+	}
+
+	if (m_buffer_events)
+		disableBufferEvents();
+
+	m_buffer_events = false;
+
+	alSourceStop(m_source);
+	alSourcei(m_source, AL_BUFFER, 0);
+	alDeleteSources(1, &m_source);
+	alDeleteBuffers(ALsizei(m_buffers.size()), m_buffers.data());
+
+	m_instrument->allNotesOff();
+	m_free_count = 0;
+
+	alcMakeContextCurrent(nullptr);
+	alcDestroyContext(m_context);
+	alcCloseDevice(m_device);
+
+	m_context = nullptr;
+	m_device = nullptr;
+}
+
+bool OpenALBackend::enableBufferEvents()
+{
+	if (!alIsExtensionPresent("AL_SOFT_events"))
+		return false;
+
+	const auto control = reinterpret_cast<EventControlProc>(alGetProcAddress("alEventControlSOFT"));
+	const auto callback = reinterpret_cast<EventCallbackProc>(alGetProcAddress("alEventCallbackSOFT"));
+	if (control == nullptr || callback == nullptr)
+		return false;
+
+	alGetError();
+
+	callback(&OpenALBackend::onEvent, this);
+
+	const ALenum types[] = {EVENT_TYPE_BUFFER_COMPLETED};
+	control(1, types, AL_TRUE);
+
+	return alGetError() == AL_NO_ERROR;
+}
+
+void OpenALBackend::disableBufferEvents()
+{
+	const auto control = reinterpret_cast<EventControlProc>(alGetProcAddress("alEventControlSOFT"));
+	const auto callback = reinterpret_cast<EventCallbackProc>(alGetProcAddress("alEventCallbackSOFT"));
+
+	const ALenum types[] = {EVENT_TYPE_BUFFER_COMPLETED};
+	control(1, types, AL_FALSE);
+	callback(nullptr, nullptr);
+}
+
+/* static */ void OpenALBackend::onEvent(ALenum type, ALuint object, ALuint, ALsizei, const char *, void *user)
+{
+	auto *const backend = static_cast<OpenALBackend *>(user);
+
+	// Called on OpenAL's own thread
+	if (type == EVENT_TYPE_BUFFER_COMPLETED && object == backend->m_source) {
+		backend->m_buffer_played = true;
+		backend->m_wakeup.notify();
+	}
+}
+
+void OpenALBackend::commandQueued()
+{
+	m_wakeup.notify();
+}
+
+std::size_t OpenALBackend::queuedFrames() const
+{
+	return (m_buffers.size() - m_free_count) * Instrument::BLOCK_SIZE;
+}
+
+void OpenALBackend::queueBlock(ALuint buffer)
+{
+	renderBlock(*m_instrument, m_volume, m_mix_block.data(), m_mix_block.size());
+
+	for (std::size_t i = 0; i < m_mix_block.size(); i++)
+		m_sample_block[i] = std::int16_t(m_mix_block[i] * 32767.0f);
+
+	alBufferData(buffer, AL_FORMAT_MONO16, m_sample_block.data(), ALsizei(sizeof(m_sample_block)), ALsizei(Instrument::SAMPLE_RATE));
+	alSourceQueueBuffers(m_source, 1, &buffer);
+}
+
+void OpenALBackend::renderThread()
+{
+	const auto block = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	    std::chrono::duration<double>(double(Instrument::BLOCK_SIZE) / double(Instrument::SAMPLE_RATE)));
+
+	while (m_running) {
+		m_buffer_played = false;
+
+		applyCommands(*m_instrument, m_volume);
+
+		ALint processed = 0;
+		alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
+
+		while (processed-- > 0) {
+			ALuint buffer = 0;
+			alSourceUnqueueBuffers(m_source, 1, &buffer);
+			m_free_buffers[m_free_count++] = buffer;
+		}
+
+		// Once the last voice has faded out the stream is left to run dry, unless the
+		// song's clock has to keep running through a rest
+		while (m_free_count > 0 && (m_instrument->active() || songPending()))
+			queueBlock(m_free_buffers[--m_free_count]);
+
+		const bool streaming = m_free_count < m_buffers.size();
+
+		ALint state = 0;
+		alGetSourcei(m_source, AL_SOURCE_STATE, &state);
+
+		// Starts the stream, or restarts it after an underrun
+		if (state != AL_PLAYING && streaming)
+			alSourcePlay(m_source);
+
+		// A new note is rendered into a free buffer right away, and a played buffer is
+		// refilled as soon as OpenAL reports it. Without the events, the next buffer
+		// frees up after a block has played; with them, the timeout is only a fallback.
+		std::chrono::steady_clock::duration interval = block;
+
+		if (!streaming)
+			interval = IDLE_INTERVAL;
+		else if (m_buffer_events)
+			interval = block * std::int64_t(m_buffers.size() / 2);
+
+		m_wakeup.waitUntil(std::chrono::steady_clock::now() + interval, [this] {
+			return !m_running || !m_commands.empty() || m_buffer_played;
+		});
+	}
+}
+#endif
@@ -0,0 +1,75 @@
+#ifndef PIANO_OPENAL_BACKEND_H
+#define PIANO_OPENAL_BACKEND_H
+
+#if PIANO_AL_ENABLED
+#include <AL.h>
+#include <ALC.h>
+
+#include "audio_backend.h"
+#include "instrument.h"
+#include "wakeup.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//! Streams a software instrument through a single OpenAL source. A render thread keeps
+//! the source's buffers filled and is the only one touching the instrument.
+class OpenALBackend : public AudioBackend {
+public:
+	//! Fewer blocks queued on the source leave no room for the render thread to be late
+	constexpr static const std::size_t MIN_STREAM_BUFFERS = 3;
+
+	//! The blocks queued on the source to cover the given output latency
+	static std::size_t bufferCount(unsigned latency_ms);
+
+private:
+	ALCdevice *m_device;
+	ALCcontext *m_context;
+	ALuint m_source;
+	std::vector<ALuint> m_buffers;
+
+	//! Only used by the render thread from here on
+	std::unique_ptr<Instrument> m_instrument;
+	float m_volume;
+	//! Buffers that aren't queued on the source
+	std::vector<ALuint> m_free_buffers;
+	std::size_t m_free_count;
+
+	//! Set from OpenAL's mixer when a buffer has played, if AL_SOFT_events is available
+	std::atomic_bool m_buffer_played;
+	bool m_buffer_events;
+	std::array<float, Instrument::BLOCK_SIZE> m_mix_block;
+	std::array<std::int16_t, Instrument::BLOCK_SIZE> m_sample_block;
+
+	std::atomic_bool m_running;
+	Wakeup m_wakeup;
+	std::thread m_thread;
+
+	void queueBlock(ALuint buffer);
+	void renderThread();
+
+	//! Asks OpenAL to report played buffers, so the render thread refills on the event
+	//! instead of guessing with a timer
+	bool enableBufferEvents();
+	void disableBufferEvents();
+	static void onEvent(ALenum type, ALuint object, ALuint param, ALsizei length, const char *message, void *user);
+
+protected:
+	void commandQueued() override;
+	std::size_t queuedFrames() const override;
+
+public:
+	//! @param latency_ms how much audio is kept queued on the source
+	OpenALBackend(std::unique_ptr<Instrument> instrument, unsigned latency_ms);
+	~OpenALBackend() override;
+
+	bool begin() override;
+	void end() override;
+};
+#endif
+
+#endif // !defined(PIANO_OPENAL_BACKEND_H)
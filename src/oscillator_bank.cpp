@@ -0,0 +1,99 @@
+#include "oscillator_bank.h"
+
+#include "oscillator_kernels.h"
+
+#include <assert.h>
+
+#if PIANO_OSCILLATORS_X86 && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+#if PIANO_OSCILLATORS_X86
+bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+	int info[4] = {};
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The OS has to save the YMM registers too
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+} // namespace
+
+/* static */ std::vector<OscillatorBank::KernelInfo> OscillatorBank::availableKernels()
+{
+	std::vector<KernelInfo> result = {scalarKernel()};
+
+#if PIANO_OSCILLATORS_X86
+	result.push_back({"sse2", renderOscillatorsSse2});
+
+	if (cpuSupportsAvx2())
+		result.push_back({"avx2", renderOscillatorsAvx2});
+#endif
+
+#if PIANO_OSCILLATORS_NEON
+	result.push_back({"neon", renderOscillatorsNeon});
+#endif
+
+	return result;
+}
+
+/* static */ OscillatorBank::KernelInfo OscillatorBank::bestKernel()
+{
+	static const KernelInfo best = availableKernels().back();
+	return best;
+}
+
+/* static */ OscillatorBank::KernelInfo OscillatorBank::scalarKernel()
+{
+	return {"scalar", renderOscillatorsScalar};
+}
+
+OscillatorBank::OscillatorBank(Waveform waveform, Kernel kernel)
+    : m_waveform(waveform), m_kernel(kernel), m_tables(Wavetables::instance().data()), m_voices(), m_count(0) {}
+
+std::size_t OscillatorBank::add(std::uint32_t increment)
+{
+	assert(m_count < CAPACITY && "The oscillator bank is full.");
+
+	const std::size_t index = m_count++;
+
+	m_voices.phase[index] = 0;
+	m_voices.increment[index] = increment;
+	m_voices.table[index] = Wavetables::offset(m_waveform, increment);
+	m_voices.gain[index] = 0.0f;
+	m_voices.gain_step[index] = 0.0f;
+
+	return index;
+}
+
+void OscillatorBank::remove(std::size_t index)
+{
+	const std::size_t last = --m_count;
+
+	m_voices.phase[index] = m_voices.phase[last];
+	m_voices.increment[index] = m_voices.increment[last];
+	m_voices.table[index] = m_voices.table[last];
+	m_voices.gain[index] = m_voices.gain[last];
+	m_voices.gain_step[index] = m_voices.gain_step[last];
+
+	// Kernels render whole lanes, so the unused slots must stay silent
+	m_voices.gain[last] = 0.0f;
+	m_voices.gain_step[last] = 0.0f;
+}
@@ -0,0 +1,89 @@
+#ifndef PIANO_OSCILLATOR_BANK_H
+#define PIANO_OSCILLATOR_BANK_H
+
+#include "wavetables.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! The phase accumulators and gain ramps of every voice of a Synth, stored as one
+//! array per field so the SIMD kernels can advance several voices per instruction.
+//!
+//! A voice's phase covers a full period over 2^32; its gain is clamped to [0, 1]
+//! after gain_step is added every frame. Each voice reads the Wavetables level that
+//! suits its pitch.
+class OscillatorBank {
+public:
+	using Waveform = Wavetables::Waveform;
+
+	//! The widest kernel renders this many voices at once
+	constexpr static const std::size_t MAX_LANES = 8;
+	constexpr static const std::size_t CAPACITY = 256;
+	//! Kernels accumulate at most this many frames before mixing their lanes down
+	constexpr static const std::size_t MAX_KERNEL_FRAMES = 256;
+
+	struct Voices {
+		alignas(32) std::array<std::uint32_t, CAPACITY> phase;
+		alignas(32) std::array<std::uint32_t, CAPACITY> increment;
+		//! Where the voice's table starts in Wavetables::data()
+		alignas(32) std::array<std::uint32_t, CAPACITY> table;
+		alignas(32) std::array<float, CAPACITY> gain;
+		alignas(32) std::array<float, CAPACITY> gain_step;
+	};
+
+	//! Adds the next frames of voices [0, count) to out. Kernels may render the voices
+	//! up to count rounded up to their lane width too, so those have to be silent.
+	using Kernel = void (*)(const float *tables, Voices &voices, std::size_t count, float *out, std::size_t frames);
+
+	struct KernelInfo {
+		const char *name;
+		Kernel kernel;
+	};
+
+	//! The kernels this CPU can run, the fastest last
+	static std::vector<KernelInfo> availableKernels();
+	static KernelInfo bestKernel();
+	//! Renders the same samples on every CPU, unlike the SIMD kernels
+	static KernelInfo scalarKernel();
+
+private:
+	Waveform m_waveform;
+	Kernel m_kernel;
+	const float *m_tables;
+
+	Voices m_voices;
+	std::size_t m_count;
+
+public:
+	OscillatorBank(Waveform waveform, Kernel kernel = bestKernel().kernel);
+
+	//! Starts a silent voice at the end; its gain is set with setGain()
+	//! @returns the voice's index
+	std::size_t add(std::uint32_t increment);
+	//! Replaces a voice with the last one, which takes its index
+	void remove(std::size_t index);
+
+	inline void setGain(std::size_t index, float gain, float gain_step)
+	{
+		m_voices.gain[index] = gain;
+		m_voices.gain_step[index] = gain_step;
+	}
+
+	inline void setGainStep(std::size_t index, float gain_step) { m_voices.gain_step[index] = gain_step; }
+
+	inline float gain(std::size_t index) const { return m_voices.gain[index]; }
+	inline std::size_t size() const { return m_count; }
+
+	inline void clear()
+	{
+		while (m_count > 0)
+			remove(m_count - 1);
+	}
+
+	//! Adds the next frames of every voice to out
+	inline void render(float *out, std::size_t frames) { m_kernel(m_tables, m_voices, m_count, out, frames); }
+};
+
+#endif // !defined(PIANO_OSCILLATOR_BANK_H)
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef PIANO_OSCILLATOR_KERNELS_H
+#define PIANO_OSCILLATOR_KERNELS_H
+
+#include "oscillator_bank.h"
+
+//! Every kernel reads each voice's table at the top bits of its phase and
+//! interpolates linearly with the bits below.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIANO_OSCILLATORS_X86 1
+#else
+#define PIANO_OSCILLATORS_X86 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define PIANO_OSCILLATORS_NEON 1
+#else
+#define PIANO_OSCILLATORS_NEON 0
+#endif
+
+//! Scales the phase bits below the table index to [0, 1)
+constexpr static const float OSCILLATOR_FRACTION_SCALE = 1.0f / float(1u << Wavetables::FRACTION_BITS);
+constexpr static const std::uint32_t OSCILLATOR_FRACTION_MASK = (1u << Wavetables::FRACTION_BITS) - 1;
+
+void renderOscillatorsScalar(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames);
+
+#if PIANO_OSCILLATORS_X86
+void renderOscillatorsSse2(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames);
+//! Built with AVX2 enabled; only call it if the CPU supports it
+void renderOscillatorsAvx2(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames);
+#endif
+
+#if PIANO_OSCILLATORS_NEON
+void renderOscillatorsNeon(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames);
+#endif
+
+#endif // !defined(PIANO_OSCILLATOR_KERNELS_H)
\ No newline at end of file
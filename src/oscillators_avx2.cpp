@@ -0,0 +1,69 @@
+#include "oscillator_kernels.h"
+
+#if PIANO_OSCILLATORS_X86
+#include <immintrin.h>
+
+#include <algorithm>
+
+namespace {
+constexpr static const std::size_t LANES = 8;
+
+inline float sum(__m256 v)
+{
+	const __m128 halves = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	const __m128 pairs = _mm_add_ps(halves, _mm_movehl_ps(halves, halves));
+	return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+} // namespace
+
+void renderOscillatorsAvx2(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames)
+{
+	alignas(32) __m256 mix[OscillatorBank::MAX_KERNEL_FRAMES];
+
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(OSCILLATOR_FRACTION_SCALE);
+	const __m256i fraction_mask = _mm256_set1_epi32(std::int32_t(OSCILLATOR_FRACTION_MASK));
+	const __m256i next = _mm256_set1_epi32(1);
+
+	for (std::size_t begin = 0; begin < frames; begin += OscillatorBank::MAX_KERNEL_FRAMES) {
+		const std::size_t n = std::min(frames - begin, OscillatorBank::MAX_KERNEL_FRAMES);
+
+		for (std::size_t i = 0; i < n; i++)
+			mix[i] = zero;
+
+		for (std::size_t v = 0; v < count; v += LANES) {
+			__m256i phase = _mm256_load_si256(reinterpret_cast<const __m256i *>(&voices.phase[v]));
+			__m256 gain = _mm256_load_ps(&voices.gain[v]);
+			const __m256i increment = _mm256_load_si256(reinterpret_cast<const __m256i *>(&voices.increment[v]));
+			const __m256i table = _mm256_load_si256(reinterpret_cast<const __m256i *>(&voices.table[v]));
+			const __m256 gain_step = _mm256_load_ps(&voices.gain_step[v]);
+
+			// Lanes that are silent and stay silent only need their phase moved on
+			if (_mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(gain, zero, _CMP_GT_OQ), _mm256_cmp_ps(gain_step, zero, _CMP_GT_OQ))) == 0) {
+				for (std::size_t lane = v; lane < v + LANES; lane++)
+					voices.phase[lane] += std::uint32_t(voices.increment[lane] * n);
+				continue;
+			}
+
+			for (std::size_t i = 0; i < n; i++) {
+				const __m256i index = _mm256_add_epi32(table, _mm256_srli_epi32(phase, Wavetables::FRACTION_BITS));
+
+				const __m256 a = _mm256_i32gather_ps(tables, index, 4);
+				const __m256 b = _mm256_i32gather_ps(tables, _mm256_add_epi32(index, next), 4);
+				const __m256 fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(phase, fraction_mask)), scale);
+
+				const __m256 sample = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fraction));
+				mix[i] = _mm256_add_ps(mix[i], _mm256_mul_ps(sample, gain));
+
+				phase = _mm256_add_epi32(phase, increment);
+				gain = _mm256_min_ps(one, _mm256_max_ps(zero, _mm256_add_ps(gain, gain_step)));
+			}
+
+			_mm256_store_si256(reinterpret_cast<__m256i *>(&voices.phase[v]), phase);
+			_mm256_store_ps(&voices.gain[v], gain);
+		}
+
+		for (std::size_t i = 0; i < n; i++)
+			out[begin + i] += sum(mix[i]);
+	}
+}
+#endif
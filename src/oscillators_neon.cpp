@@ -0,0 +1,76 @@
+#include "oscillator_kernels.h"
+
+#if PIANO_OSCILLATORS_NEON
+#include <arm_neon.h>
+
+#include <algorithm>
+
+namespace {
+constexpr static const std::size_t LANES = 4;
+
+inline float sum(float32x4_t v)
+{
+	const float32x2_t pairs = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpadd_f32(pairs, pairs), 0);
+}
+} // namespace
+
+void renderOscillatorsNeon(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames)
+{
+	float32x4_t mix[OscillatorBank::MAX_KERNEL_FRAMES];
+	std::uint32_t indices[LANES];
+	float a_lanes[LANES], b_lanes[LANES];
+
+	const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f), scale = vdupq_n_f32(OSCILLATOR_FRACTION_SCALE);
+	const uint32x4_t fraction_mask = vdupq_n_u32(OSCILLATOR_FRACTION_MASK);
+
+	for (std::size_t begin = 0; begin < frames; begin += OscillatorBank::MAX_KERNEL_FRAMES) {
+		const std::size_t n = std::min(frames - begin, OscillatorBank::MAX_KERNEL_FRAMES);
+
+		for (std::size_t i = 0; i < n; i++)
+			mix[i] = zero;
+
+		for (std::size_t v = 0; v < count; v += LANES) {
+			uint32x4_t phase = vld1q_u32(&voices.phase[v]);
+			float32x4_t gain = vld1q_f32(&voices.gain[v]);
+			const uint32x4_t increment = vld1q_u32(&voices.increment[v]);
+			const uint32x4_t table = vld1q_u32(&voices.table[v]);
+			const float32x4_t gain_step = vld1q_f32(&voices.gain_step[v]);
+
+			// Lanes that are silent and stay silent only need their phase moved on
+			const uint32x4_t audible = vorrq_u32(vcgtq_f32(gain, zero), vcgtq_f32(gain_step, zero));
+			if ((vgetq_lane_u32(audible, 0) | vgetq_lane_u32(audible, 1) | vgetq_lane_u32(audible, 2) | vgetq_lane_u32(audible, 3)) == 0) {
+				for (std::size_t lane = v; lane < v + LANES; lane++)
+					voices.phase[lane] += std::uint32_t(voices.increment[lane] * n);
+				continue;
+			}
+
+			for (std::size_t i = 0; i < n; i++) {
+				// NEON can't gather, so the table reads are scalar
+				vst1q_u32(indices, vaddq_u32(table, vshrq_n_u32(phase, Wavetables::FRACTION_BITS)));
+
+				for (std::size_t lane = 0; lane < LANES; lane++) {
+					a_lanes[lane] = tables[indices[lane]];
+					b_lanes[lane] = tables[indices[lane] + 1];
+				}
+
+				const float32x4_t a = vld1q_f32(a_lanes);
+				const float32x4_t b = vld1q_f32(b_lanes);
+				const float32x4_t fraction = vmulq_f32(vcvtq_f32_u32(vandq_u32(phase, fraction_mask)), scale);
+
+				const float32x4_t sample = vmlaq_f32(a, vsubq_f32(b, a), fraction);
+				mix[i] = vmlaq_f32(mix[i], sample, gain);
+
+				phase = vaddq_u32(phase, increment);
+				gain = vminq_f32(one, vmaxq_f32(zero, vaddq_f32(gain, gain_step)));
+			}
+
+			vst1q_u32(&voices.phase[v], phase);
+			vst1q_f32(&voices.gain[v], gain);
+		}
+
+		for (std::size_t i = 0; i < n; i++)
+			out[begin + i] += sum(mix[i]);
+	}
+}
+#endif
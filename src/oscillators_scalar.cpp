@@ -0,0 +1,33 @@
+#include "oscillator_kernels.h"
+
+#include <algorithm>
+
+void renderOscillatorsScalar(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames)
+{
+	for (std::size_t v = 0; v < count; v++) {
+		std::uint32_t phase = voices.phase[v];
+		float gain = voices.gain[v];
+		const std::uint32_t increment = voices.increment[v];
+		const float gain_step = voices.gain_step[v];
+		const float *table = tables + voices.table[v];
+
+		// Silent voices that stay silent cost nothing
+		if (gain == 0.0f && gain_step <= 0.0f) {
+			voices.phase[v] = phase + std::uint32_t(increment * frames);
+			continue;
+		}
+
+		for (std::size_t i = 0; i < frames; i++) {
+			const std::uint32_t index = phase >> Wavetables::FRACTION_BITS;
+			const float fraction = float(phase & OSCILLATOR_FRACTION_MASK) * OSCILLATOR_FRACTION_SCALE;
+
+			out[i] += (table[index] + (table[index + 1] - table[index]) * fraction) * gain;
+
+			phase += increment;
+			gain = std::min(1.0f, std::max(0.0f, gain + gain_step));
+		}
+
+		voices.phase[v] = phase;
+		voices.gain[v] = gain;
+	}
+}
@@ -0,0 +1,69 @@
+#include "oscillator_kernels.h"
+
+#if PIANO_OSCILLATORS_X86
+#include <emmintrin.h>
+
+#include <algorithm>
+
+namespace {
+constexpr static const std::size_t LANES = 4;
+
+inline float sum(__m128 v)
+{
+	const __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+} // namespace
+
+void renderOscillatorsSse2(const float *tables, OscillatorBank::Voices &voices, std::size_t count, float *out, std::size_t frames)
+{
+	alignas(16) __m128 mix[OscillatorBank::MAX_KERNEL_FRAMES];
+	alignas(16) std::uint32_t indices[LANES];
+
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(OSCILLATOR_FRACTION_SCALE);
+	const __m128i fraction_mask = _mm_set1_epi32(std::int32_t(OSCILLATOR_FRACTION_MASK));
+
+	for (std::size_t begin = 0; begin < frames; begin += OscillatorBank::MAX_KERNEL_FRAMES) {
+		const std::size_t n = std::min(frames - begin, OscillatorBank::MAX_KERNEL_FRAMES);
+
+		for (std::size_t i = 0; i < n; i++)
+			mix[i] = zero;
+
+		for (std::size_t v = 0; v < count; v += LANES) {
+			__m128i phase = _mm_load_si128(reinterpret_cast<const __m128i *>(&voices.phase[v]));
+			__m128 gain = _mm_load_ps(&voices.gain[v]);
+			const __m128i increment = _mm_load_si128(reinterpret_cast<const __m128i *>(&voices.increment[v]));
+			const __m128i table = _mm_load_si128(reinterpret_cast<const __m128i *>(&voices.table[v]));
+			const __m128 gain_step = _mm_load_ps(&voices.gain_step[v]);
+
+			// Lanes that are silent and stay silent only need their phase moved on
+			if (_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(gain, zero), _mm_cmpgt_ps(gain_step, zero))) == 0) {
+				for (std::size_t lane = v; lane < v + LANES; lane++)
+					voices.phase[lane] += std::uint32_t(voices.increment[lane] * n);
+				continue;
+			}
+
+			for (std::size_t i = 0; i < n; i++) {
+				// SSE2 can't gather, so the table reads are scalar
+				_mm_store_si128(reinterpret_cast<__m128i *>(indices), _mm_add_epi32(table, _mm_srli_epi32(phase, Wavetables::FRACTION_BITS)));
+
+				const __m128 a = _mm_setr_ps(tables[indices[0]], tables[indices[1]], tables[indices[2]], tables[indices[3]]);
+				const __m128 b = _mm_setr_ps(tables[indices[0] + 1], tables[indices[1] + 1], tables[indices[2] + 1], tables[indices[3] + 1]);
+				const __m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(phase, fraction_mask)), scale);
+
+				const __m128 sample = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction));
+				mix[i] = _mm_add_ps(mix[i], _mm_mul_ps(sample, gain));
+
+				phase = _mm_add_epi32(phase, increment);
+				gain = _mm_min_ps(one, _mm_max_ps(zero, _mm_add_ps(gain, gain_step)));
+			}
+
+			_mm_store_si128(reinterpret_cast<__m128i *>(&voices.phase[v]), phase);
+			_mm_store_ps(&voices.gain[v], gain);
+		}
+
+		for (std::size_t i = 0; i < n; i++)
+			out[begin + i] += sum(mix[i]);
+	}
+}
+#endif
@@ -0,0 +1,178 @@
+#include "posix_serial.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+// termios2 lets us set arbitrary baud rates (BOTHER); it clashes with <termios.h>,
+// so everything goes through ioctl() here.
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#else
+#include <termios.h>
+#endif
+
+namespace {
+tcflag_t byteSizeFlag(unsigned int byte_size)
+{
+	switch (byte_size) {
+		case 5:
+			return CS5;
+		case 6:
+			return CS6;
+		case 7:
+			return CS7;
+		default:
+			return CS8;
+	}
+}
+} // namespace
+
+PosixSerial::PosixSerial() : m_fd(-1), m_buffer(), m_head(0), m_tail(0) {}
+
+bool PosixSerial::configure(unsigned int baud, Serial::Settings settings)
+{
+	if (settings.stop_bits == Serial::StopBits::ONE_AND_A_HALF)
+		return false;
+
+#if defined(__linux__)
+	struct termios2 tio;
+	if (ioctl(m_fd, TCGETS2, &tio) != 0)
+		return false;
+#else
+	struct termios tio;
+	if (tcgetattr(m_fd, &tio) != 0)
+		return false;
+#endif
+
+	// Raw mode: no line discipline, no translation, no flow control
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+
+	tio.c_cflag &= ~(CSIZE | PARENB | PARODD | CSTOPB);
+	tio.c_cflag |= CREAD | CLOCAL | byteSizeFlag(settings.byte_size);
+
+	if (settings.parity != Serial::Parity::NONE)
+		tio.c_cflag |= PARENB | (settings.parity == Serial::Parity::ODD ? PARODD : 0);
+
+	if (settings.stop_bits == Serial::StopBits::TWO)
+		tio.c_cflag |= CSTOPB;
+
+	// Reads never block in the driver; waiting is done with poll()
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+
+#if defined(__linux__)
+	tio.c_cflag &= ~CBAUD;
+	tio.c_cflag |= BOTHER;
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+
+	if (ioctl(m_fd, TCSETS2, &tio) != 0)
+		return false;
+
+	ioctl(m_fd, TCFLSH, TCIFLUSH);
+#else
+	cfsetispeed(&tio, baud);
+	cfsetospeed(&tio, baud);
+
+	if (tcsetattr(m_fd, TCSANOW, &tio) != 0)
+		return false;
+
+	tcflush(m_fd, TCIFLUSH);
+#endif
+
+	return true;
+}
+
+void PosixSerial::setLowLatency()
+{
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+	// Not every driver supports this (pseudo terminals don't), so failure is not an error
+	struct serial_struct serinfo;
+	if (ioctl(m_fd, TIOCGSERIAL, &serinfo) == 0) {
+		serinfo.flags |= ASYNC_LOW_LATENCY;
+		ioctl(m_fd, TIOCSSERIAL, &serinfo);
+	}
+#endif
+}
+
+std::size_t PosixSerial::fill()
+{
+	// Once closed, poll() ignores the descriptor and just waits out the timeout
+	struct pollfd pfd = {m_fd, POLLIN, 0};
+	if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0)
+		return 0;
+
+	// A hangup or an error is reported straight away on every poll, so the port is
+	// closed rather than have the caller spin on it
+	if ((pfd.revents & POLLIN) == 0) {
+		if ((pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0)
+			end();
+
+		return 0;
+	}
+
+	// The buffer is only refilled once drained, so the whole of it is free
+	m_head = 0;
+	m_tail = 0;
+
+	const ssize_t bytes_read = ::read(m_fd, m_buffer.data(), m_buffer.size());
+
+	// Readable but empty is the end of the file: the device is gone
+	if (bytes_read == 0)
+		end();
+
+	if (bytes_read <= 0)
+		return 0;
+
+	m_tail = static_cast<std::size_t>(bytes_read);
+	return m_tail;
+}
+
+/* virtual */ bool PosixSerial::begin(const std::string &port, unsigned int baud, Serial::Settings settings) /* override */
+{
+	m_fd = open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (m_fd < 0)
+		return false;
+
+	if (!configure(baud, settings)) {
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	setLowLatency();
+
+	m_head = 0;
+	m_tail = 0;
+
+	return true;
+}
+
+/* virtual */ void PosixSerial::end() /* override */
+{
+	if (m_fd >= 0)
+		close(m_fd);
+
+	m_fd = -1;
+}
+
+/* virtual */ std::size_t PosixSerial::read(std::uint8_t *out, std::size_t size) /* override */
+{
+	if (m_head == m_tail && fill() == 0)
+		return 0;
+
+	const std::size_t count = std::min(size, m_tail - m_head);
+	std::memcpy(out, m_buffer.data() + m_head, count);
+	m_head += count;
+
+	return count;
+}
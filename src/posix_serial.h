@@ -0,0 +1,37 @@
+#ifndef PIANO_POSIX_SERIAL_H
+#define PIANO_POSIX_SERIAL_H
+
+#include "serial.h"
+
+#include <array>
+
+class PosixSerial : public Serial {
+public:
+	constexpr static const std::size_t BUFFER_SIZE = 4096;
+	constexpr static const int READ_TIMEOUT_MS = 10;
+
+protected:
+	int m_fd;
+
+	//! Bytes are pulled from the port in bulk and handed out from here,
+	//! so a single syscall serves as many read() calls as it can.
+	std::array<std::uint8_t, BUFFER_SIZE> m_buffer;
+	std::size_t m_head, m_tail;
+
+	bool configure(unsigned int baud, Serial::Settings settings);
+	void setLowLatency();
+	std::size_t fill();
+
+public:
+	PosixSerial();
+
+	virtual bool begin(const std::string &port, unsigned int baud, Serial::Settings settings) override;
+	virtual void end() override;
+
+	virtual std::size_t read(std::uint8_t *out, std::size_t size) override;
+
+	virtual int descriptor() const override { return m_fd; }
+	virtual bool buffered() const override { return m_head != m_tail; }
+};
+
+#endif // !defined(PIANO_POSIX_SERIAL_H)
@@ -0,0 +1,57 @@
+#include "recording_serial.h"
+
+#include <iostream>
+
+RecordingSerial::RecordingSerial(std::unique_ptr<Serial> serial, const std::string &path)
+    : m_serial(std::move(serial)), m_path(path), m_file(), m_last_record() {}
+
+void RecordingSerial::writeVarint(std::uint64_t value)
+{
+	do {
+		const std::uint8_t byte = (value & 0x7F) | (value > 0x7F ? 0x80 : 0x00);
+		m_file.put(char(byte));
+		value >>= 7;
+	} while (value != 0);
+}
+
+/* virtual */ bool RecordingSerial::begin(const std::string &port, unsigned int baud, Serial::Settings settings) /* override */
+{
+	m_file.open(m_path, std::ios::binary | std::ios::trunc);
+	if (!m_file) {
+		std::cerr << "Couldn't create recording " << m_path << std::endl;
+		return false;
+	}
+
+	if (!m_serial->begin(port, baud, settings)) {
+		m_file.close();
+		return false;
+	}
+
+	m_file.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	m_last_record = clock::now();
+
+	return true;
+}
+
+/* virtual */ void RecordingSerial::end() /* override */
+{
+	m_serial->end();
+	m_file.close();
+}
+
+/* virtual */ std::size_t RecordingSerial::read(std::uint8_t *out, std::size_t size) /* override */
+{
+	const std::size_t count = m_serial->read(out, size);
+	if (count == 0)
+		return 0;
+
+	const auto now = clock::now();
+
+	writeVarint(std::chrono::duration_cast<std::chrono::microseconds>(now - m_last_record).count());
+	writeVarint(count);
+	m_file.write(reinterpret_cast<const char *>(out), count);
+
+	m_last_record = now;
+
+	return count;
+}
@@ -0,0 +1,41 @@
+#ifndef PIANO_RECORDING_SERIAL_H
+#define PIANO_RECORDING_SERIAL_H
+
+#include "serial.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+//! Passes another port through while writing everything read from it to a file.
+//!
+//! The file starts with RECORDING_MAGIC followed by one record per read():
+//! the time since the previous record in microseconds and the byte count, both
+//! as LEB128 varints, then the bytes themselves.
+class RecordingSerial : public Serial {
+public:
+	constexpr static const char RECORDING_MAGIC[8] = {'P', 'N', 'O', 'R', 'E', 'C', '0', '1'};
+
+	using clock = std::chrono::steady_clock;
+
+protected:
+	std::unique_ptr<Serial> m_serial;
+	std::string m_path;
+	std::ofstream m_file;
+	clock::time_point m_last_record;
+
+	void writeVarint(std::uint64_t value);
+
+public:
+	RecordingSerial(std::unique_ptr<Serial> serial, const std::string &path);
+
+	virtual bool begin(const std::string &port, unsigned int baud, Serial::Settings settings) override;
+	virtual void end() override;
+
+	virtual std::size_t read(std::uint8_t *out, std::size_t size) override;
+
+	virtual int descriptor() const override { return m_serial->descriptor(); }
+	virtual bool buffered() const override { return m_serial->buffered(); }
+};
+
+#endif // !defined(PIANO_RECORDING_SERIAL_H)
@@ -0,0 +1,114 @@
+#include "replay_serial.h"
+
+#include "recording_serial.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+ReplaySerial::ReplaySerial(double speed)
+    : m_speed(speed), m_data(), m_position(0),
+      m_record_begin(0), m_record_end(0), m_record_time(0),
+      m_started(false), m_start() {}
+
+bool ReplaySerial::readVarint(std::uint64_t &value)
+{
+	value = 0;
+
+	for (unsigned shift = 0; m_position < m_data.size() && shift < 64; shift += 7) {
+		const std::uint8_t byte = m_data[m_position++];
+		value |= std::uint64_t(byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool ReplaySerial::nextRecord()
+{
+	std::uint64_t delta = 0, size = 0;
+
+	if (!readVarint(delta) || !readVarint(size) || size > m_data.size() - m_position) {
+		// Nothing more to play, or a recording cut short
+		m_position = m_data.size();
+		return false;
+	}
+
+	m_record_time += std::chrono::microseconds(delta);
+	m_record_begin = m_position;
+	m_record_end = m_position + size;
+	m_position = m_record_end;
+
+	return true;
+}
+
+/* virtual */ bool ReplaySerial::begin(const std::string &port, unsigned int /* baud */, Serial::Settings /* settings */) /* override */
+{
+	std::ifstream file(port, std::ios::binary);
+	if (!file) {
+		std::cerr << "Couldn't open recording " << port << std::endl;
+		return false;
+	}
+
+	m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	const auto &magic = RecordingSerial::RECORDING_MAGIC;
+	if (m_data.size() < sizeof(magic) || std::memcmp(m_data.data(), magic, sizeof(magic)) != 0) {
+		std::cerr << port << " is not a serial recording" << std::endl;
+		m_data.clear();
+		return false;
+	}
+
+	m_position = sizeof(magic);
+	m_record_begin = m_record_end = 0;
+	m_record_time = std::chrono::microseconds(0);
+	m_started = false;
+
+	return true;
+}
+
+/* virtual */ void ReplaySerial::end() /* override */
+{
+	m_data.clear();
+	m_position = 0;
+	m_record_begin = m_record_end = 0;
+}
+
+/* virtual */ std::size_t ReplaySerial::read(std::uint8_t *out, std::size_t size) /* override */
+{
+	if (m_record_begin == m_record_end && !nextRecord()) {
+		// Behave like an idle port rather than spinning the reader
+		std::this_thread::sleep_for(std::chrono::milliseconds(READ_TIMEOUT_MS));
+		return 0;
+	}
+
+	const auto now = clock::now();
+
+	if (!m_started) {
+		m_started = true;
+		m_start = now;
+	}
+
+	if (m_speed > 0.0) {
+		const auto due = m_start + std::chrono::duration_cast<clock::duration>(
+		                               std::chrono::duration<double, std::micro>(m_record_time.count() / m_speed));
+
+		if (due > now) {
+			std::this_thread::sleep_for(std::min<clock::duration>(due - now, std::chrono::milliseconds(READ_TIMEOUT_MS)));
+
+			if (clock::now() < due)
+				return 0;
+		}
+	}
+
+	const std::size_t count = std::min(size, m_record_end - m_record_begin);
+	std::memcpy(out, m_data.data() + m_record_begin, count);
+	m_record_begin += count;
+
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef PIANO_REPLAY_SERIAL_H
+#define PIANO_REPLAY_SERIAL_H
+
+#include "serial.h"
+
+#include <chrono>
+#include <vector>
+
+//! Plays back a file written by RecordingSerial in place of a real port.
+//! begin() takes the path of the recording as the port; the line settings are ignored.
+class ReplaySerial : public Serial {
+public:
+	constexpr static const char *PORT_PREFIX = "replay:";
+	constexpr static const int READ_TIMEOUT_MS = 10;
+
+	using clock = std::chrono::steady_clock;
+
+protected:
+	//! 1 is the original speed, 0 replays as fast as possible
+	double m_speed;
+
+	std::vector<std::uint8_t> m_data;
+	std::size_t m_position;
+
+	//! The bytes of the record being handed out and the time they become readable
+	std::size_t m_record_begin, m_record_end;
+	std::chrono::microseconds m_record_time;
+
+	bool m_started;
+	clock::time_point m_start;
+
+	bool readVarint(std::uint64_t &value);
+	bool nextRecord();
+
+public:
+	explicit ReplaySerial(double speed = 1.0);
+
+	virtual bool begin(const std::string &port, unsigned int baud, Serial::Settings settings) override;
+	virtual void end() override;
+
+	virtual std::size_t read(std::uint8_t *out, std::size_t size) override;
+
+	inline bool finished() const { return m_record_begin == m_record_end && m_position == m_data.size(); }
+};
+
+#endif // !defined(PIANO_REPLAY_SERIAL_H)
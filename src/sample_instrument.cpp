@@ -0,0 +1,408 @@
+#include "sample_instrument.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace {
+std::uint16_t readU16(const std::uint8_t *p)
+{
+	return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+std::uint32_t readU32(const std::uint8_t *p)
+{
+	return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+bool isNumber(const std::string &text)
+{
+	return !text.empty() && text.size() <= 3 && std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+}
+
+//! Reads file names like C4, C#4, 60, C4_v80 or 60_v100
+bool parseSampleName(std::string name, std::uint8_t &root, unsigned &velocity)
+{
+	velocity = SampleInstrument::VELOCITY;
+
+	const auto separator = name.rfind('_');
+	if (separator != std::string::npos) {
+		const std::string layer = name.substr(separator + 1);
+
+		if (layer.size() < 2 || std::tolower(static_cast<unsigned char>(layer[0])) != 'v' || !isNumber(layer.substr(1)))
+			return false;
+
+		velocity = unsigned(std::stoul(layer.substr(1)));
+		name = name.substr(0, separator);
+	}
+
+	unsigned midi = 0;
+
+	if (isNumber(name)) {
+		midi = unsigned(std::stoul(name));
+	}
+	else {
+		std::istringstream stream(name);
+		Note note;
+
+		if (!(stream >> note) || stream.peek() != std::char_traits<char>::eof())
+			return false;
+
+		midi = unsigned(note.octave) * 12 + unsigned(note.key) + 12;
+	}
+
+	if (midi >= SampleInstrument::NUM_KEYS)
+		return false;
+
+	root = std::uint8_t(midi);
+	return true;
+}
+} // namespace
+
+float SampleInstrument::Sample::decode(std::size_t index) const
+{
+	const std::uint8_t *p = file.data() + data_offset + index * frame_size;
+	float sum = 0.0f;
+
+	switch (format) {
+		case FORMAT_PCM16:
+			for (unsigned c = 0; c < channels; c++)
+				sum += float(std::int16_t(readU16(p + 2 * c))) * (1.0f / 32768.0f);
+			break;
+		case FORMAT_PCM24:
+			for (unsigned c = 0; c < channels; c++) {
+				const std::uint8_t *q = p + 3 * c;
+				// Shifted into the top bytes first, so the sign is extended
+				const std::int32_t value = std::int32_t((std::uint32_t(q[0]) << 8) | (std::uint32_t(q[1]) << 16) | (std::uint32_t(q[2]) << 24)) >> 8;
+				sum += float(value) * (1.0f / 8388608.0f);
+			}
+			break;
+		case FORMAT_FLOAT32:
+			for (unsigned c = 0; c < channels; c++) {
+				float value;
+				std::memcpy(&value, p + 4 * c, sizeof(value));
+				sum += value;
+			}
+			break;
+	}
+
+	return sum / float(channels);
+}
+
+SampleInstrument::SampleInstrument(unsigned polyphony)
+    : m_samples(), m_key_samples(), m_voices(), m_polyphony(std::max(1u, polyphony)), m_started(0),
+      m_release_step(1.0f / (RELEASE_SECONDS * float(SAMPLE_RATE))), m_prefetch_requests(), m_prefetching(true),
+      m_prefetch_wakeup(), m_prefetch_thread()
+{
+	m_voices.reserve(m_polyphony);
+	m_prefetch_thread = std::thread(&SampleInstrument::prefetchThread, this);
+}
+
+SampleInstrument::~SampleInstrument()
+{
+	m_prefetching = false;
+	m_prefetch_wakeup.notify();
+	m_prefetch_thread.join();
+}
+
+bool SampleInstrument::load(const std::string &directory)
+{
+	struct Candidate {
+		std::string path;
+		unsigned distance;
+	};
+
+	// Only the closest velocity layer of each key is mapped
+	std::map<std::uint8_t, Candidate> candidates;
+	std::error_code error;
+
+	for (auto entry = std::filesystem::directory_iterator(directory, error); !error && entry != std::filesystem::directory_iterator(); entry.increment(error)) {
+		std::string extension = entry->path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+		if (extension != ".wav" || !entry->is_regular_file())
+			continue;
+
+		std::uint8_t root = 0;
+		unsigned velocity = 0;
+
+		if (!parseSampleName(entry->path().stem().string(), root, velocity)) {
+			std::cerr << "Skipping " << entry->path().string() << ", the name isn't a note like C#4, 60 or C#4_v80." << std::endl;
+			continue;
+		}
+
+		const unsigned distance = unsigned(std::abs(int(velocity) - int(VELOCITY)));
+		const auto found = candidates.find(root);
+
+		if (found == candidates.end() || distance < found->second.distance)
+			candidates[root] = Candidate{entry->path().string(), distance};
+	}
+
+	if (error) {
+		std::cerr << "Couldn't read the sample directory " << directory << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	for (const auto &candidate : candidates)
+		loadSample(candidate.second.path, candidate.first);
+
+	if (m_samples.empty()) {
+		std::cerr << "No samples were found in " << directory << "." << std::endl;
+		return false;
+	}
+
+	// The samples are sorted by root, so a key halfway between two is played from the lower one
+	for (std::size_t key = 0; key < NUM_KEYS; key++) {
+		const auto nearest = std::min_element(m_samples.begin(), m_samples.end(), [key](const auto &a, const auto &b) {
+			return std::abs(int(a->root) - int(key)) < std::abs(int(b->root) - int(key));
+		});
+
+		m_key_samples[key] = nearest->get();
+	}
+
+	return true;
+}
+
+bool SampleInstrument::loadSample(const std::string &path, std::uint8_t root)
+{
+	auto sample = std::make_unique<Sample>();
+
+	if (!sample->file.open(path))
+		return false;
+
+	const std::uint8_t *data = sample->file.data();
+	const std::size_t size = sample->file.size();
+
+	if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+		std::cerr << path << " isn't a WAV file." << std::endl;
+		return false;
+	}
+
+	std::uint16_t tag = 0, channels = 0, bits = 0;
+	std::uint32_t rate = 0;
+	std::size_t data_offset = 0, data_size = 0;
+
+	for (std::size_t offset = 12; offset + 8 <= size;) {
+		const std::size_t body = offset + 8;
+		const std::size_t chunk_size = readU32(data + offset + 4);
+
+		if (std::memcmp(data + offset, "fmt ", 4) == 0 && chunk_size >= 16 && body + 16 <= size) {
+			tag = readU16(data + body);
+			channels = readU16(data + body + 2);
+			rate = readU32(data + body + 4);
+			bits = readU16(data + body + 14);
+
+			// WAVE_FORMAT_EXTENSIBLE keeps the actual format at the start of the sub-format GUID
+			if (tag == 0xFFFE && chunk_size >= 40 && body + 26 <= size)
+				tag = readU16(data + body + 24);
+		}
+		else if (std::memcmp(data + offset, "data", 4) == 0) {
+			data_offset = body;
+			data_size = std::min(chunk_size, size - std::min(size, body));
+		}
+
+		// Chunks are padded to an even size
+		offset = body + chunk_size + (chunk_size & 1);
+	}
+
+	if (tag == 1 && bits == 16) {
+		sample->format = Sample::FORMAT_PCM16;
+	}
+	else if (tag == 1 && bits == 24) {
+		sample->format = Sample::FORMAT_PCM24;
+	}
+	else if (tag == 3 && bits == 32) {
+		sample->format = Sample::FORMAT_FLOAT32;
+	}
+	else {
+		std::cerr << path << " isn't 16 or 24 bit PCM or 32 bit float." << std::endl;
+		return false;
+	}
+
+	if (channels == 0 || rate == 0) {
+		std::cerr << path << " has no channels or sample rate." << std::endl;
+		return false;
+	}
+
+	sample->channels = channels;
+	sample->rate = rate;
+	sample->frame_size = std::size_t(channels) * bits / 8;
+	sample->data_offset = data_offset;
+	sample->frames = data_size / sample->frame_size;
+	sample->root = root;
+
+	if (sample->frames < 2) {
+		std::cerr << path << " has no audio data." << std::endl;
+		return false;
+	}
+
+	sample->file.advise(data_offset, data_size, MappedFile::ADVICE_SEQUENTIAL);
+
+	const std::size_t preload = std::min(sample->frames, std::size_t(PRELOAD_SECONDS * float(rate)));
+	sample->attack.reserve(preload);
+
+	for (std::size_t i = 0; i < preload; i++)
+		sample->attack.push_back(sample->decode(i));
+
+	// The attack is only read from memory from now on
+	sample->file.advise(data_offset, preload * sample->frame_size, MappedFile::ADVICE_DONT_NEED);
+
+	m_samples.push_back(std::move(sample));
+
+	return true;
+}
+
+void SampleInstrument::noteOn(Note note)
+{
+	const std::size_t key = note.toMidi();
+	if (key >= NUM_KEYS || m_key_samples[key] == nullptr)
+		return;
+
+	// A key struck again lets its last note ring out under the new one
+	noteOff(note);
+
+	if (m_voices.size() == m_polyphony) {
+		// Steal the quietest releasing voice, or the oldest one if all are held
+		const auto stolen = std::min_element(m_voices.begin(), m_voices.end(), [](const Voice &a, const Voice &b) {
+			return a.held != b.held ? !a.held : (a.held ? a.started < b.started : a.gain < b.gain);
+		});
+
+		*stolen = m_voices.back();
+		m_voices.pop_back();
+	}
+
+	const Sample *sample = m_key_samples[key];
+	const double ratio = std::exp2((double(key) - double(sample->root)) / 12.0) * double(sample->rate) / double(SAMPLE_RATE);
+
+	const std::size_t prefetch_frames = std::max<std::size_t>(1, std::size_t(PREFETCH_SECONDS * double(SAMPLE_RATE) * ratio));
+
+	m_voices.push_back(Voice{sample, 0, std::uint64_t(ratio * 4294967296.0), 1.0f, 0.0f, note, true, ++m_started, sample->attack.size(), prefetch_frames});
+}
+
+void SampleInstrument::noteOff(Note note)
+{
+	for (auto &voice : m_voices) {
+		if (voice.note == note && voice.held) {
+			voice.held = false;
+			voice.gain_step = -m_release_step;
+		}
+	}
+}
+
+void SampleInstrument::allNotesOff()
+{
+	m_voices.clear();
+}
+
+void SampleInstrument::render(float *out, std::size_t frames)
+{
+	std::fill(out, out + frames, 0.0f);
+
+	for (auto &voice : m_voices) {
+		const Sample &sample = *voice.sample;
+		const std::uint64_t end = std::uint64_t(sample.frames - 1) << 32;
+
+		for (std::size_t i = 0; i < frames; i++) {
+			if (voice.position >= end || voice.gain <= 0.0f) {
+				voice.gain = 0.0f;
+				break;
+			}
+
+			const std::size_t index = std::size_t(voice.position >> 32);
+			const float fraction = float(voice.position & 0xFFFFFFFFu) * (1.0f / 4294967296.0f);
+			const float a = sample.frame(index);
+			const float b = sample.frame(index + 1);
+
+			out[i] += (a + (b - a) * fraction) * voice.gain;
+
+			voice.position += voice.increment;
+			voice.gain += voice.gain_step;
+		}
+
+		if (voice.gain > 0.0f)
+			requestPrefetch(voice);
+	}
+
+	for (std::size_t i = 0; i < frames; i++)
+		out[i] *= VOICE_GAIN;
+
+	// Faded out and finished voices make room for new ones
+	m_voices.erase(std::remove_if(m_voices.begin(), m_voices.end(), [](const Voice &voice) { return voice.gain <= 0.0f; }), m_voices.end());
+}
+
+void SampleInstrument::prefetch(Note note) const
+{
+	const std::size_t key = note.toMidi();
+	if (key >= NUM_KEYS || m_key_samples[key] == nullptr)
+		return;
+
+	const Sample &sample = *m_key_samples[key];
+	if (sample.frames <= sample.attack.size())
+		return;
+
+	// Higher keys play faster than the sample's rate and need more of it
+	const double ratio = std::max(1.0, std::exp2((double(key) - double(sample.root)) / 12.0));
+	const std::size_t frames = std::size_t(PREFETCH_SECONDS * double(sample.rate) * ratio);
+
+	sample.file.advise(sample.data_offset + sample.attack.size() * sample.frame_size, frames * sample.frame_size, MappedFile::ADVICE_WILL_NEED);
+}
+
+void SampleInstrument::requestPrefetch(Voice &voice)
+{
+	const Sample &sample = *voice.sample;
+	const std::size_t index = std::size_t(voice.position >> 32);
+
+	if (voice.prefetched >= sample.frames || index + voice.prefetch_frames < voice.prefetched)
+		return;
+
+	const std::size_t frames = std::min(voice.prefetch_frames, sample.frames - voice.prefetched);
+
+	// A full queue is tried again on the next block
+	if (m_prefetch_requests.push(PrefetchRequest{&sample, voice.prefetched, frames}))
+		voice.prefetched += frames;
+}
+
+void SampleInstrument::prefetchThread()
+{
+	while (m_prefetching) {
+		PrefetchRequest request;
+
+		while (m_prefetch_requests.pop(request)) {
+			const Sample &sample = *request.sample;
+			const std::size_t offset = sample.data_offset + request.frame * sample.frame_size;
+			const std::size_t length = request.frames * sample.frame_size;
+
+			sample.file.advise(offset, length, MappedFile::ADVICE_WILL_NEED);
+
+			// The advice is only a hint; a read makes sure any page fault happens here
+			const volatile std::uint8_t *data = sample.file.data();
+			std::uint8_t sum = 0;
+
+			for (std::size_t i = offset; i < offset + length; i += PAGE_SIZE)
+				sum ^= data[i];
+			sum ^= data[offset + length - 1];
+			(void)sum;
+		}
+
+		// Polled, so the render thread never takes the wakeup's mutex
+		m_prefetch_wakeup.waitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(PREFETCH_INTERVAL_MS), [this] {
+			return !m_prefetching;
+		});
+	}
+}
+
+std::size_t SampleInstrument::preloadedBytes() const
+{
+	std::size_t result = 0;
+
+	for (const auto &sample : m_samples)
+		result += sample->attack.size() * sizeof(float);
+
+	return result;
+}
@@ -0,0 +1,138 @@
+#ifndef PIANO_SAMPLE_INSTRUMENT_H
+#define PIANO_SAMPLE_INSTRUMENT_H
+
+#include "instrument.h"
+#include "mapped_file.h"
+#include "notes.h"
+#include "spsc_queue.h"
+#include "wakeup.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Plays a directory of recorded notes: one WAV file per key, optionally per velocity
+//! layer, named like C4.wav, 60.wav or C#4_v80.wav. Keys without a recording are
+//! resampled from the nearest one.
+//!
+//! Only the attack of each sample is decoded into memory. The rest is read from the
+//! mapped file as the note plays, so large sample sets load quickly and only the
+//! parts being played stay resident. A prefetch thread touches each voice's next
+//! second of sample ahead of the render thread, which still faults if the kernel
+//! drops those pages again before they're played.
+class SampleInstrument : public Instrument {
+public:
+	//! The part of each sample decoded at load, covering the time until the prefetch
+	//! thread has read the rest of the note's start
+	constexpr static const float PRELOAD_SECONDS = 0.25f;
+	//! How far ahead of each voice its sample is read, in seconds of playback
+	constexpr static const float PREFETCH_SECONDS = 1.0f;
+	//! How often the prefetch thread looks for requests from the render thread
+	constexpr static const unsigned PREFETCH_INTERVAL_MS = 20;
+	constexpr static const std::size_t PAGE_SIZE = 4096;
+	constexpr static const float RELEASE_SECONDS = 0.1f;
+	constexpr static const float VOICE_GAIN = 0.5f;
+	//! The keyboard doesn't report velocity, so the layer closest to this is loaded
+	constexpr static const unsigned VELOCITY = 80;
+	constexpr static const std::size_t NUM_KEYS = 128;
+
+private:
+	struct Sample {
+		enum Format : std::uint8_t {
+			FORMAT_PCM16,
+			FORMAT_PCM24,
+			FORMAT_FLOAT32
+		};
+
+		MappedFile file;
+		Format format;
+		unsigned channels;
+		unsigned rate;
+		//! Bytes per frame of all channels
+		std::size_t frame_size;
+		std::size_t data_offset;
+		std::size_t frames;
+		std::uint8_t root;
+
+		//! The first frames, downmixed to mono
+		std::vector<float> attack;
+
+		//! Decodes a frame from the mapped file, downmixed to mono
+		float decode(std::size_t index) const;
+
+		inline float frame(std::size_t index) const { return index < attack.size() ? attack[index] : decode(index); }
+	};
+
+	struct Voice {
+		const Sample *sample;
+		//! In frames of the sample, as 32.32 fixed point
+		std::uint64_t position;
+		std::uint64_t increment;
+		float gain;
+		float gain_step;
+		Note note;
+		bool held;
+		std::uint64_t started;
+		//! The sample frames requested from the prefetch thread end here
+		std::size_t prefetched;
+		//! PREFETCH_SECONDS of playback, in frames of the sample
+		std::size_t prefetch_frames;
+	};
+
+	//! A range of a sample the render thread is about to play
+	struct PrefetchRequest {
+		const Sample *sample;
+		std::size_t frame;
+		std::size_t frames;
+	};
+
+	std::vector<std::unique_ptr<Sample>> m_samples;
+	//! The sample each MIDI key is played from
+	std::array<const Sample *, NUM_KEYS> m_key_samples;
+
+	std::vector<Voice> m_voices;
+	std::size_t m_polyphony;
+	std::uint64_t m_started;
+	float m_release_step;
+
+	//! Filled by the render thread, so it never waits for the disk itself
+	SpscQueue<PrefetchRequest, 256> m_prefetch_requests;
+	std::atomic_bool m_prefetching;
+	Wakeup m_prefetch_wakeup;
+	std::thread m_prefetch_thread;
+
+	bool loadSample(const std::string &path, std::uint8_t root);
+
+	//! Asks for the next part of the voice's sample once it's within PREFETCH_SECONDS
+	void requestPrefetch(Voice &voice);
+	//! Reads requested ranges into the page cache by touching every page
+	void prefetchThread();
+
+public:
+	explicit SampleInstrument(unsigned polyphony);
+	~SampleInstrument() override;
+
+	bool load(const std::string &directory);
+
+	void noteOn(Note note) override;
+	void noteOff(Note note) override;
+	void allNotesOff() override;
+
+	void render(float *out, std::size_t frames) override;
+
+	inline bool active() const override { return !m_voices.empty(); }
+
+	//! Asks the kernel to read the part of the note's sample that follows the attack
+	void prefetch(Note note) const override;
+
+	//! The memory taken by the decoded attacks
+	std::size_t preloadedBytes() const;
+	inline std::size_t sampleCount() const { return m_samples.size(); }
+};
+
+#endif // !defined(PIANO_SAMPLE_INSTRUMENT_H)
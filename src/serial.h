@@ -41,6 +41,11 @@ public:
 	virtual void end() = 0;
 
 	virtual std::size_t read(std::uint8_t *output, std::size_t count) = 0;
+
+	//! A descriptor that can be poll()ed for input, or -1 if read() has to be called to find out
+	virtual int descriptor() const { return -1; }
+	//! Whether read() still holds input from an earlier bulk read, which the descriptor won't signal
+	virtual bool buffered() const { return false; }
 };
 
 std::ostream &operator<<(std::ostream &os, const Serial::Parity &par);
@@ -0,0 +1,97 @@
+#include "serial_multiplexer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+void SerialMultiplexer::add(Serial *serial)
+{
+	m_serials.push_back(serial);
+	m_closed.push_back(false);
+
+#if !defined(_WIN32)
+	if (serial->descriptor() >= 0) {
+		m_poll_fds.push_back({serial->descriptor(), POLLIN, 0});
+		m_poll_indices.push_back(m_serials.size() - 1);
+	}
+#endif
+}
+
+#if !defined(_WIN32)
+void SerialMultiplexer::drop(std::size_t i)
+{
+	const std::size_t index = m_poll_indices[i];
+
+	std::cerr << "Serial port " << index << " was disconnected and has been closed." << std::endl;
+	m_closed[index] = true;
+
+	m_poll_fds.erase(m_poll_fds.begin() + std::ptrdiff_t(i));
+	m_poll_indices.erase(m_poll_indices.begin() + std::ptrdiff_t(i));
+}
+#endif
+
+const std::vector<std::size_t> &SerialMultiplexer::wait(int timeout_ms)
+{
+	m_ready.clear();
+
+#if !defined(_WIN32)
+	// A port that closed itself on a hangup while being read no longer owns its old
+	// descriptor, which may already belong to another file
+	for (std::size_t i = 0; i < m_poll_fds.size();) {
+		if (m_serials[m_poll_indices[i]]->descriptor() != m_poll_fds[i].fd)
+			drop(i);
+		else
+			i++;
+	}
+#endif
+
+	for (std::size_t i = 0; i < m_serials.size(); i++) {
+		if (m_closed[i])
+			continue;
+
+		if (m_serials[i]->descriptor() < 0 || m_serials[i]->buffered())
+			m_ready.push_back(i);
+	}
+
+#if !defined(_WIN32)
+	if (m_poll_fds.empty()) {
+		// Every port has been closed, which mustn't turn the caller's loop into a spin
+		if (m_ready.empty())
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+
+		return m_ready;
+	}
+
+	// Don't sleep if some port can already be read
+	const bool had_ready = !m_ready.empty();
+
+	if (poll(m_poll_fds.data(), m_poll_fds.size(), had_ready ? 0 : timeout_ms) <= 0)
+		return m_ready;
+
+	for (std::size_t i = 0; i < m_poll_fds.size();) {
+		const short revents = m_poll_fds[i].revents;
+		const std::size_t index = m_poll_indices[i];
+
+		// A port that was unplugged reports the hangup on every poll without ever
+		// having input again, so it's closed and no longer polled
+		if ((revents & POLLIN) == 0 && (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+			m_serials[index]->end();
+			drop(i);
+			continue;
+		}
+
+		if ((revents & POLLIN) != 0 && !m_serials[index]->buffered())
+			m_ready.push_back(index);
+
+		i++;
+	}
+
+	if (had_ready)
+		std::sort(m_ready.begin(), m_ready.end());
+#else
+	(void)timeout_ms;
+#endif
+
+	return m_ready;
+}
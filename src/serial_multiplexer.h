@@ -0,0 +1,46 @@
+#ifndef PIANO_SERIAL_MULTIPLEXER_H
+#define PIANO_SERIAL_MULTIPLEXER_H
+
+#include "serial.h"
+
+#include <cstddef>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
+
+//! Waits for input on several serial ports from a single thread.
+//!
+//! Ports with a descriptor() are poll()ed together. Ports without one are always
+//! reported as ready and are expected to wait briefly inside read() themselves.
+//! Ports that hang up or fail are closed and left out from then on.
+class SerialMultiplexer {
+public:
+	constexpr static const int WAIT_TIMEOUT_MS = 10;
+
+private:
+	std::vector<Serial *> m_serials;
+	std::vector<std::size_t> m_ready;
+	//! Ports closed after a hangup or an error
+	std::vector<bool> m_closed;
+
+#if !defined(_WIN32)
+	std::vector<struct pollfd> m_poll_fds;
+	std::vector<std::size_t> m_poll_indices;
+
+	//! Stops polling m_poll_fds[i] and leaves its port out from then on
+	void drop(std::size_t i);
+#endif
+
+public:
+	void add(Serial *serial);
+
+	//! Blocks until at least one port has input or the timeout passes.
+	//! @returns the indices of the ports that should be read, in the order they were added
+	const std::vector<std::size_t> &wait(int timeout_ms = WAIT_TIMEOUT_MS);
+
+	inline std::size_t size() const { return m_serials.size(); }
+};
+
+#endif // !defined(PIANO_SERIAL_MULTIPLEXER_H)
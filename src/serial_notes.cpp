@@ -1,6 +1,20 @@
 #include "serial_notes.h"
 
-/* extern */ std::map<std::uint16_t, Note> KEY_NOTE_PAIRS = {
+#include "sounds.h"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+struct KeyCode {
+	//! Row in the high byte, key bit mask in the low byte
+	std::uint16_t code;
+	Note note;
+};
+
+constexpr static const KeyCode DEFAULT_KEY_CODES[] = {
     {0x0580, {Note::C, 4}},
     {0x0540, {Note::Cs, 4}},
     {0x0520, {Note::D, 4}},
@@ -38,3 +52,97 @@
     {0x0120, {Note::As, 6}},
     {0x0110, {Note::B, 6}},
     {0x0004, {Note::C, 7}}};
+
+constexpr KeyMap makeDefaultKeyMap()
+{
+	KeyMap result(6, 8);
+
+	for (const auto &entry : DEFAULT_KEY_CODES) {
+		std::size_t bit = 0;
+		while (((entry.code >> bit) & 1u) == 0)
+			bit++;
+
+		result.set(entry.code >> 8, bit, entry.note);
+	}
+
+	return result;
+}
+} // namespace
+
+/* extern */ constexpr KeyMap DEFAULT_KEYMAP = makeDefaultKeyMap();
+
+bool KeyMap::loadFromFile(const std::string &path)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cerr << "Couldn't open keymap " << path << std::endl;
+		return false;
+	}
+
+	KeyMap result(0, 8);
+
+	std::string line;
+	for (std::size_t line_number = 1; std::getline(file, line); line_number++) {
+		// '#' also marks sharps, so a comment has to start a word
+		for (std::size_t i = 0; i < line.size(); i++) {
+			if (line[i] == '#' && (i == 0 || std::isspace(static_cast<unsigned char>(line[i - 1])))) {
+				line.erase(i);
+				break;
+			}
+		}
+
+		std::istringstream stream(line);
+		std::string first;
+		if (!(stream >> first))
+			continue;
+
+		bool valid = false;
+
+		if (first == "rows") {
+			valid = (stream >> result.m_rows) && result.m_rows > 0 && result.m_rows <= MAX_ROWS;
+		}
+		else if (first == "bits") {
+			valid = (stream >> result.m_row_bits) && (result.m_row_bits == 8 || result.m_row_bits == 16);
+		}
+		else {
+			std::size_t row = 0, bit = 0;
+			Note note;
+
+			valid = (std::istringstream(first) >> row) && (stream >> bit >> note) &&
+			        row < result.m_rows && bit < result.m_row_bits &&
+			        note.octave < Sounds::NUM_OCTAVES;
+
+			if (valid)
+				result.set(row, bit, note);
+		}
+
+		if (!valid) {
+			std::cerr << path << ":" << line_number << ": invalid keymap entry \"" << line << "\"" << std::endl;
+			return false;
+		}
+	}
+
+	*this = result;
+	return true;
+}
+
+bool KeyMap::transpose(int semitones)
+{
+	KeyMap result = *this;
+
+	for (std::size_t row = 0; row < m_rows; row++) {
+		for (std::size_t bit = 0; bit < m_row_bits; bit++) {
+			if ((m_masks[row] & (1u << bit)) == 0)
+				continue;
+
+			const int midi = int(m_notes[row][bit].toMidi()) + semitones;
+			if (midi < Note{Note::C, 0}.toMidi() || midi >= Note{Note::C, Sounds::NUM_OCTAVES}.toMidi())
+				return false;
+
+			result.m_notes[row][bit] = Note::fromMidi(std::uint8_t(midi));
+		}
+	}
+
+	*this = result;
+	return true;
+}
\ No newline at end of file
@@ -1,11 +1,53 @@
 #ifndef PIANO_SERIAL_NOTES_H
 #define PIANO_SERIAL_NOTES_H
 
-#include <map>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "notes.h"
 
-extern std::map<std::uint16_t, Note> KEY_NOTE_PAIRS;
+//! Maps the keyboard's scan matrix (row, bit) to notes through a dense table.
+//! Bit 0 is the last key character of an ASCII line and the LSB of a binary row.
+class KeyMap {
+public:
+	constexpr static const std::size_t MAX_ROWS = 16;
+	constexpr static const std::size_t MAX_ROW_BITS = 16;
+
+private:
+	std::size_t m_rows;
+	std::size_t m_row_bits;
+
+	//! The bits of each row that have a note assigned
+	std::array<std::uint16_t, MAX_ROWS> m_masks;
+	std::array<std::array<Note, MAX_ROW_BITS>, MAX_ROWS> m_notes;
+
+public:
+	constexpr KeyMap(std::size_t rows = 0, std::size_t row_bits = 8)
+	    : m_rows(rows), m_row_bits(row_bits), m_masks(), m_notes() {}
+
+	constexpr void set(std::size_t row, std::size_t bit, Note note)
+	{
+		m_notes[row][bit] = note;
+		m_masks[row] |= std::uint16_t(1u << bit);
+	}
+
+	constexpr std::size_t rows() const { return m_rows; }
+	constexpr std::size_t rowBits() const { return m_row_bits; }
+	constexpr std::size_t rowBytes() const { return (m_row_bits + 7) / 8; }
+
+	constexpr std::uint16_t mask(std::size_t row) const { return m_masks[row]; }
+	constexpr Note note(std::size_t row, std::size_t bit) const { return m_notes[row][bit]; }
+
+	//! Reads a keymap file. Lines are either "rows <n>", "bits <8|16>" or
+	//! "<row> <bit> <note>", e.g. "5 7 C#4"; a word starting with '#' begins a comment.
+	bool loadFromFile(const std::string &path);
+
+	//! Shifts every note by the given number of semitones; fails if a note would leave the supported range
+	bool transpose(int semitones);
+};
+
+extern const KeyMap DEFAULT_KEYMAP;
 
 #endif // !defined(PIANO_SERIAL_NOTES_H)
\ No newline at end of file
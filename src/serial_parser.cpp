@@ -1,67 +1,248 @@
 #include "serial_parser.h"
 
-#include "serial_notes.h"
+#include "bits.h"
 
-#include <functional>
-#include <numeric>
-#include <string>
+#include <algorithm>
 
 namespace {
-void trimString(std::string &str)
+constexpr bool isBlank(std::uint8_t c)
 {
-	str.erase(str.begin(), std::find_if(str.begin(), str.end(), [](unsigned char ch) {
-		          return !std::isspace(ch);
-	          }));
-
-	str.erase(std::find_if(str.rbegin(), str.rend(), [](unsigned char ch) {
-		          return !std::isspace(ch);
-	          }).base(),
-	          str.end());
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
 }
+
+constexpr int hexDigit(std::uint8_t c)
+{
+	return (c >= '0' && c <= '9')   ? c - '0'
+	       : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+	       : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+	                                : -1;
+}
+
+//! CRC-8 with the polynomial x^8 + x^2 + x + 1 (0x07), as used by SMBus
+struct Crc8Table {
+	std::uint8_t values[256];
+
+	constexpr Crc8Table() : values()
+	{
+		for (unsigned i = 0; i < 256; i++) {
+			std::uint8_t crc = std::uint8_t(i);
+			for (unsigned bit = 0; bit < 8; bit++)
+				crc = (crc & 0x80) ? std::uint8_t((crc << 1) ^ 0x07) : std::uint8_t(crc << 1);
+
+			values[i] = crc;
+		}
+	}
+};
+
+constexpr static const Crc8Table CRC8_TABLE;
 } // namespace
 
+/* static */ const std::map<std::string, SerialParser::Protocol> SerialParser::PROTOCOL_MAP = {
+    {"auto", SerialParser::Protocol::PROTOCOL_AUTO},
+    {"ascii", SerialParser::Protocol::PROTOCOL_ASCII},
+    {"binary", SerialParser::Protocol::PROTOCOL_BINARY}};
+
+/* static */ std::uint8_t SerialParser::crc8(const std::uint8_t *data, std::size_t size)
+{
+	std::uint8_t crc = 0;
+	for (std::size_t i = 0; i < size; i++)
+		crc = CRC8_TABLE.values[crc ^ data[i]];
+
+	return crc;
+}
+
+void SerialParser::processRow(std::uint8_t row, std::uint16_t bits, Sounds::Snapshot &pressed, Sounds::Snapshot &released)
+{
+	// Only the mapped keys that changed since the last scan of this row are touched
+	std::uint16_t changed = (bits ^ m_row_state[row]) & m_keymap->mask(row);
+	m_row_state[row] = bits;
+
+	while (changed != 0) {
+		const unsigned bit = lowestBit(changed);
+		changed &= changed - 1;
+
+		if ((bits >> bit) & 1u)
+			pressed.set(m_keymap->note(row, bit));
+		else
+			released.set(m_keymap->note(row, bit));
+	}
+}
+
+void SerialParser::commit(const Sounds::Snapshot &pressed, const Sounds::Snapshot &released)
+{
+	if (pressed.empty() && released.empty())
+		return;
+
+	const auto decoded = m_events != nullptr ? NoteEvent::clock::now() : NoteEvent::clock::time_point();
+
+	// The state goes first so a consumer resyncing after an overflow sees these changes
+	m_sounds->apply(pressed, released);
+
+	if (m_events == nullptr)
+		return;
+
+	const auto applied = NoteEvent::clock::now();
+
+	released.forEach([&](Note note) { m_events->publish(NoteEvent{m_time, decoded, applied, note, false}); });
+	pressed.forEach([&](Note note) { m_events->publish(NoteEvent{m_time, decoded, applied, note, true}); });
+
+	m_events->notify();
+}
+
 void SerialParser::processLine()
 {
-	const bool valid =
-	    (m_line.length() == 9 &&
-	     m_line[0] < '6' && m_line[0] >= '0') &&
-	    std::transform_reduce(
-	        m_line.begin() + 1, m_line.end(),
-	        true,
-	        std::logical_and{},
-	        [](const char &c) { return c == '0' || c == '1'; });
+	Sounds::Snapshot pressed{}, released{};
+	processRow(m_row, m_bits, pressed, released);
 
-	if (valid) {
-		const std::uint16_t octaveNumber = (m_line[0] - '0') << 8;
+	commit(pressed, released);
+}
 
-		const std::uint16_t keyNumber = std::stoi(m_line.substr(1), nullptr, 0b10);
+void SerialParser::processFrame()
+{
+	const std::uint8_t sequence = m_frame[0];
 
-		for (std::size_t i = 0; i < 8; i++) {
+	if (m_sequence_valid)
+		m_statistics.dropped += std::uint8_t(sequence - m_sequence - 1);
 
-			const std::uint16_t mask = 1u << i;
-			const std::uint16_t keyCode = octaveNumber | mask;
+	m_sequence = sequence;
+	m_sequence_valid = true;
 
-			if (KEY_NOTE_PAIRS.count(keyCode) != 0) {
-				const bool isDown = (keyNumber & mask) != 0;
-				const auto keyLookup = KEY_NOTE_PAIRS.at(keyCode);
+	const std::uint8_t *rows = m_frame.data() + 1;
+	Sounds::Snapshot pressed{}, released{};
 
-				m_sounds->safeToggleNote(keyLookup, isDown);
-			}
+	if (m_keymap->rowBytes() == 1) {
+		for (std::size_t row = 0; row < m_keymap->rows(); row++)
+			processRow(std::uint8_t(row), rows[row], pressed, released);
+	}
+	else {
+		for (std::size_t row = 0; row < m_keymap->rows(); row++)
+			processRow(std::uint8_t(row), std::uint16_t((rows[2 * row] << 8) | rows[2 * row + 1]), pressed, released);
+	}
+
+	// The whole scan reaches the other threads at once
+	commit(pressed, released);
+}
+
+void SerialParser::reject(std::uint8_t byte)
+{
+	m_statistics.malformed++;
+
+	if (byte == SYNC_BYTE && m_protocol != PROTOCOL_ASCII)
+		beginFrame();
+	else
+		m_state = byte == '\n' && m_protocol != PROTOCOL_BINARY ? State::IDLE : State::RESYNC;
+}
+
+void SerialParser::beginFrame()
+{
+	m_frame_size = 0;
+	m_state = State::FRAME;
+}
+
+void SerialParser::feed(const std::uint8_t *data, std::size_t size, NoteEvent::clock::time_point time)
+{
+	m_statistics.bytes += size;
+	m_time = time;
+
+	for (std::size_t i = 0; i < size; i++) {
+		const std::uint8_t c = data[i];
+
+		switch (m_state) {
+			case State::IDLE:
+				if (c == SYNC_BYTE && m_protocol != PROTOCOL_ASCII) {
+					beginFrame();
+				}
+				else if (m_protocol == PROTOCOL_BINARY) {
+					reject(c);
+				}
+				else if (hexDigit(c) >= 0 && std::size_t(hexDigit(c)) < m_keymap->rows()) {
+					m_row = std::uint8_t(hexDigit(c));
+					m_bits = 0;
+					m_bit_count = 0;
+					m_state = State::BITS;
+				}
+				else if (c != '\n' && !isBlank(c)) {
+					reject(c);
+				}
+				break;
+
+			case State::BITS:
+				if (c == '0' || c == '1') {
+					m_bits = (m_bits << 1) | (c - '0');
+
+					if (++m_bit_count == m_keymap->rowBits())
+						m_state = State::TRAILER;
+				}
+				else {
+					reject(c);
+				}
+				break;
+
+			case State::TRAILER:
+				if (c == '\n') {
+					m_statistics.lines++;
+					processLine();
+					m_state = State::IDLE;
+				}
+				else if (!isBlank(c)) {
+					reject(c);
+				}
+				break;
+
+			case State::FRAME:
+				m_frame[m_frame_size++] = c;
+
+				if (m_frame_size == framePayloadSize(*m_keymap) + 1) {
+					const auto frame_end = m_frame.begin() + m_frame_size;
+
+					if (crc8(m_frame.data(), m_frame_size - 1) == m_frame[m_frame_size - 1]) {
+						m_statistics.frames++;
+						processFrame();
+						m_state = State::IDLE;
+					}
+					else {
+						m_statistics.malformed++;
+
+						// The sync byte may have been a data byte; retry from the next one we saw
+						const auto next_sync = std::find(m_frame.begin(), frame_end, SYNC_BYTE);
+
+						if (next_sync != frame_end) {
+							m_frame_size = std::uint8_t(std::copy(next_sync + 1, frame_end, m_frame.begin()) - m_frame.begin());
+						}
+						else {
+							m_state = State::RESYNC;
+						}
+					}
+				}
+				break;
+
+			case State::RESYNC:
+				if (c == SYNC_BYTE && m_protocol != PROTOCOL_ASCII)
+					beginFrame();
+				else if (c == '\n' && m_protocol != PROTOCOL_BINARY)
+					m_state = State::IDLE;
+				break;
 		}
 	}
 }
 
 void SerialParser::update()
 {
-	std::uint8_t byte = 0x00;
-	if (m_serial->read(&byte, sizeof(byte)) == sizeof(byte)) {
-		if (byte == '\n') {
-			trimString(m_line);
-			processLine();
-			m_line = "";
-		}
-		else {
-			m_line += (char)byte;
+	std::uint8_t buffer[READ_CHUNK_SIZE];
+	const std::size_t count = m_serial->read(buffer, sizeof(buffer));
+
+	if (count > 0)
+		feed(buffer, count, NoteEvent::clock::now());
+}
+
+std::ostream &operator<<(std::ostream &os, const SerialParser::Protocol &protocol)
+{
+	for (const auto &entry : SerialParser::PROTOCOL_MAP) {
+		if (entry.second == protocol) {
+			os << entry.first;
+			break;
 		}
 	}
+
+	return os;
 }
\ No newline at end of file
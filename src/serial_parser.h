@@ -1,27 +1,119 @@
 #ifndef PIANO_SERIAL_PARSER_H
 #define PIANO_SERIAL_PARSER_H
 
+#include "note_events.h"
 #include "sounds.h"
 
 #include "serial.h"
+#include "serial_notes.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+//! Incremental parser for the two formats the scanner can send.
+//!
+//! ASCII: one hex row digit followed by the row's key bits (MSB first) and a
+//! newline, e.g. "510000000\n". Surrounding whitespace is ignored; anything else
+//! makes the parser skip to the next newline.
+//!
+//! Binary: SYNC_BYTE, a sequence number, each matrix row as big-endian raw bytes
+//! and a CRC-8 over the sequence number and the rows. A full keyboard scan fits
+//! in one frame.
+//!
+//! The row count and width of both formats come from the keymap.
+//!
+//! Every change is applied to Sounds and, if given, published to the
+//! NoteEventQueues stamped with the time its bytes were read.
 class SerialParser {
+public:
+	enum Protocol : std::uint8_t {
+		PROTOCOL_AUTO,
+		PROTOCOL_ASCII,
+		PROTOCOL_BINARY
+	};
+
+	constexpr static const std::size_t READ_CHUNK_SIZE = 256;
+
+	constexpr static const std::uint8_t SYNC_BYTE = 0xA5;
+	constexpr static const std::size_t MAX_FRAME_PAYLOAD_SIZE = 1 + KeyMap::MAX_ROWS * KeyMap::MAX_ROW_BITS / 8;
+
+	struct Statistics {
+		std::uint64_t bytes;
+		std::uint64_t lines;
+		std::uint64_t frames;
+		std::uint64_t malformed;
+		std::uint64_t dropped;
+	};
+
+	static const std::map<std::string, Protocol> PROTOCOL_MAP;
+
 private:
+	enum class State : std::uint8_t {
+		IDLE,
+		BITS,
+		TRAILER,
+		FRAME,
+		RESYNC
+	};
+
 	Serial *m_serial;
 	Sounds *m_sounds;
+	NoteEventQueues *m_events;
+	const KeyMap *m_keymap;
+	Protocol m_protocol;
 
-	std::string m_line;
+	State m_state;
+	std::uint8_t m_row;
+	std::uint8_t m_bit_count;
+	std::uint16_t m_bits;
+
+	std::array<std::uint16_t, KeyMap::MAX_ROWS> m_row_state;
+
+	std::array<std::uint8_t, MAX_FRAME_PAYLOAD_SIZE + 1> m_frame;
+	std::uint8_t m_frame_size;
+	std::uint8_t m_sequence;
+	bool m_sequence_valid;
+
+	Statistics m_statistics;
+
+	//! When the bytes being fed were read
+	NoteEvent::clock::time_point m_time;
 
 private:
+	void processRow(std::uint8_t row, std::uint16_t bits, Sounds::Snapshot &pressed, Sounds::Snapshot &released);
+	void commit(const Sounds::Snapshot &pressed, const Sounds::Snapshot &released);
 	void processLine();
+	void processFrame();
+	void reject(std::uint8_t byte);
+	void beginFrame();
 
 public:
-	inline SerialParser(Serial *serial, Sounds *sounds)
-	    : m_serial(serial), m_sounds(sounds), m_line() {}
+	static std::uint8_t crc8(const std::uint8_t *data, std::size_t size);
+
+	//! The sequence number and the rows
+	static constexpr std::size_t framePayloadSize(const KeyMap &keymap) { return 1 + keymap.rows() * keymap.rowBytes(); }
+	//! The sync byte, the payload and the CRC
+	static constexpr std::size_t frameSize(const KeyMap &keymap) { return 1 + framePayloadSize(keymap) + 1; }
+
+	//! @param events may be null if nothing consumes note events
+	inline SerialParser(Serial *serial, Sounds *sounds, NoteEventQueues *events, const KeyMap *keymap, Protocol protocol = PROTOCOL_AUTO)
+	    : m_serial(serial), m_sounds(sounds), m_events(events), m_keymap(keymap), m_protocol(protocol),
+	      m_state(State::IDLE), m_row(0), m_bit_count(0), m_bits(0),
+	      m_row_state(), m_frame(), m_frame_size(0), m_sequence(0), m_sequence_valid(false),
+	      m_statistics(), m_time() {}
 
 	~SerialParser() = default;
 
+	void feed(const std::uint8_t *data, std::size_t size, NoteEvent::clock::time_point time = NoteEvent::clock::now());
 	void update();
+
+	inline const Statistics &statistics() const { return m_statistics; }
 };
 
+std::ostream &operator<<(std::ostream &os, const SerialParser::Protocol &protocol);
+
 #endif // !defined(PIANO_SERIAL_PARSER_H)
\ No newline at end of file
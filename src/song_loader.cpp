@@ -0,0 +1,216 @@
+#include "song_loader.h"
+
+#include "midi_reader.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+constexpr static const char CACHE_MAGIC[4] = {'P', 'S', 'N', 'G'};
+//! Bumped whenever the layout or the way songs are compiled changes, including the
+//! order notes are stored in: version 3 sorts notes by start across all tracks
+constexpr static const std::uint32_t CACHE_VERSION = 3;
+
+//! Written in the host's byte order; the cache never leaves the machine. The header is
+//! followed by the timeline's arrays one after another: begins, durations, tracks, keys.
+struct CacheHeader {
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t hash;
+	std::int32_t transpose;
+	std::uint8_t lowest;
+	std::uint8_t highest;
+	std::uint16_t reserved;
+	std::uint64_t count;
+};
+
+static_assert(sizeof(CacheHeader) == 32, "The cache header must not have padding.");
+
+constexpr static const std::size_t CACHE_NOTE_SIZE = sizeof(float) * 2 + sizeof(std::uint16_t) + sizeof(std::uint8_t);
+
+template <typename T>
+const std::uint8_t *readArray(const std::uint8_t *data, std::vector<T> &array)
+{
+	std::memcpy(array.data(), data, array.size() * sizeof(T));
+	return data + array.size() * sizeof(T);
+}
+
+template <typename T>
+void writeArray(std::ofstream &file, const std::vector<T> &array)
+{
+	file.write(reinterpret_cast<const char *>(array.data()), std::streamsize(array.size() * sizeof(T)));
+}
+
+//! FNV-1a over the whole file
+std::uint64_t hashBytes(const std::uint8_t *data, std::size_t size)
+{
+	std::uint64_t hash = 0xCBF29CE484222325ull;
+
+	for (std::size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+} // namespace
+
+SongLoader::SongLoader() : m_state(STATE_IDLE), m_thread(), m_timeline() {}
+
+SongLoader::~SongLoader()
+{
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+/* static */ bool SongLoader::parse(const MappedFile &file, const Options &options, SongTimeline &timeline)
+{
+	file.advise(0, file.size(), MappedFile::ADVICE_SEQUENTIAL);
+
+	MidiReader reader(MidiReader::Settings{options.transpose, options.lowest, options.highest});
+	if (!reader.read(file.data(), file.size(), timeline)) {
+		std::cerr << "Couldn't read the midi file " << options.path << "." << std::endl;
+		return false;
+	}
+
+	if (reader.skipped() > 0)
+		std::cerr << reader.skipped() << " notes of " << options.path << " are out of range and were left out." << std::endl;
+
+	return true;
+}
+
+/* static */ std::string SongLoader::cachePath(const Options &options, std::uint64_t hash)
+{
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << "_" << options.transpose << ".song";
+
+	return (std::filesystem::path(options.cache_directory) / name.str()).string();
+}
+
+/* static */ bool SongLoader::readCache(const std::string &path, const Options &options, std::uint64_t hash, SongTimeline &timeline)
+{
+	std::error_code error;
+	if (!std::filesystem::exists(path, error))
+		return false;
+
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	const bool valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+	                   header.version == CACHE_VERSION &&
+	                   header.hash == hash &&
+	                   header.transpose == options.transpose &&
+	                   header.lowest == options.lowest.toMidi() &&
+	                   header.highest == options.highest.toMidi() &&
+	                   file.size() == sizeof(CacheHeader) + header.count * CACHE_NOTE_SIZE;
+
+	if (!valid)
+		return false;
+
+	timeline.resize(std::size_t(header.count));
+
+	const std::uint8_t *data = file.data() + sizeof(CacheHeader);
+	data = readArray(data, timeline.begins);
+	data = readArray(data, timeline.durations);
+	data = readArray(data, timeline.tracks);
+	readArray(data, timeline.keys);
+
+	return true;
+}
+
+/* static */ bool SongLoader::writeCache(const std::string &path, const Options &options, std::uint64_t hash, const SongTimeline &timeline)
+{
+	std::error_code error;
+	std::filesystem::create_directories(options.cache_directory, error);
+
+	// Written aside and renamed, so a reader never sees half a file
+	const std::string temporary = path + ".tmp";
+
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		CacheHeader header;
+		std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = CACHE_VERSION;
+		header.hash = hash;
+		header.transpose = options.transpose;
+		header.lowest = options.lowest.toMidi();
+		header.highest = options.highest.toMidi();
+		header.reserved = 0;
+		header.count = timeline.size();
+
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		writeArray(file, timeline.begins);
+		writeArray(file, timeline.durations);
+		writeArray(file, timeline.tracks);
+		writeArray(file, timeline.keys);
+
+		if (!file)
+			return false;
+	}
+
+	std::filesystem::rename(temporary, path, error);
+
+	return !error;
+}
+
+/* static */ bool SongLoader::load(const Options &options, SongTimeline &timeline)
+{
+	MappedFile midi;
+	if (!midi.open(options.path)) {
+		std::cerr << "Couldn't open the midi file " << options.path << "." << std::endl;
+		return false;
+	}
+
+	std::uint64_t hash = 0;
+	std::string cache;
+
+	if (!options.cache_directory.empty()) {
+		hash = hashBytes(midi.data(), midi.size());
+		cache = cachePath(options, hash);
+
+		if (readCache(cache, options, hash, timeline))
+			return true;
+	}
+
+	if (!parse(midi, options, timeline))
+		return false;
+
+	if (!cache.empty() && !writeCache(cache, options, hash, timeline))
+		std::cerr << "Couldn't write the song cache " << cache << "." << std::endl;
+
+	return true;
+}
+
+void SongLoader::start(const Options &options)
+{
+	if (m_thread.joinable())
+		m_thread.join();
+
+	m_state = STATE_LOADING;
+
+	m_thread = std::thread([this, options]() {
+		const auto begin = std::chrono::steady_clock::now();
+
+		if (!load(options, m_timeline)) {
+			m_state = STATE_FAILED;
+			return;
+		}
+
+		std::cout << "Loaded " << m_timeline.size() << " notes of " << options.path << " in "
+		          << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() << " ms." << std::endl;
+
+		m_state = STATE_READY;
+	});
+}
@@ -0,0 +1,65 @@
+#ifndef PIANO_SONG_LOADER_H
+#define PIANO_SONG_LOADER_H
+
+#include "mapped_file.h"
+#include "notes.h"
+#include "song_timeline.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Turns a midi file into the notes of the song, on a background thread so the window
+//! keeps drawing. The result is kept in a binary cache keyed by the file's contents and
+//! the transposition, which later launches map instead of parsing the file again.
+class SongLoader {
+public:
+	enum State : std::uint8_t {
+		STATE_IDLE,
+		STATE_LOADING,
+		STATE_READY,
+		STATE_FAILED
+	};
+
+	struct Options {
+		std::string path;
+		int transpose;
+		//! Notes outside the range are left out
+		Note lowest;
+		Note highest;
+		//! Where the compiled songs are kept; empty to always parse the file
+		std::string cache_directory;
+	};
+
+private:
+	std::atomic<State> m_state;
+	std::thread m_thread;
+	//! Only read once the state is STATE_READY
+	SongTimeline m_timeline;
+
+	static bool parse(const MappedFile &file, const Options &options, SongTimeline &timeline);
+	static std::string cachePath(const Options &options, std::uint64_t hash);
+	static bool readCache(const std::string &path, const Options &options, std::uint64_t hash, SongTimeline &timeline);
+	static bool writeCache(const std::string &path, const Options &options, std::uint64_t hash, const SongTimeline &timeline);
+
+public:
+	SongLoader();
+	~SongLoader();
+
+	SongLoader(const SongLoader &) = delete;
+	SongLoader &operator=(const SongLoader &) = delete;
+
+	//! Loads the song on the calling thread, from the cache if it's there
+	static bool load(const Options &options, SongTimeline &timeline);
+
+	//! Loads the song in the background
+	void start(const Options &options);
+
+	inline State state() const { return m_state; }
+	//! Only valid once state() is STATE_READY
+	inline const SongTimeline &timeline() const { return m_timeline; }
+};
+
+#endif // !defined(PIANO_SONG_LOADER_H)
@@ -0,0 +1,78 @@
+#ifndef PIANO_SONG_TIMELINE_H
+#define PIANO_SONG_TIMELINE_H
+
+#include "notes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! The notes of a song, one array per field, so a scan over the start times doesn't
+//! drag the rest of each note through the cache. Times are in seconds from the start,
+//! and the notes are in order of their start.
+struct SongTimeline {
+	//! MIDI numbers
+	std::vector<std::uint8_t> keys;
+	std::vector<std::uint16_t> tracks;
+	std::vector<float> begins;
+	std::vector<float> durations;
+
+	inline std::size_t size() const { return keys.size(); }
+	inline bool empty() const { return keys.empty(); }
+
+	inline Note note(std::size_t i) const { return Note::fromMidi(keys[i]); }
+	inline float end(std::size_t i) const { return begins[i] + durations[i]; }
+
+	inline void reserve(std::size_t count)
+	{
+		keys.reserve(count);
+		tracks.reserve(count);
+		begins.reserve(count);
+		durations.reserve(count);
+	}
+
+	inline void resize(std::size_t count)
+	{
+		keys.resize(count);
+		tracks.resize(count);
+		begins.resize(count);
+		durations.resize(count);
+	}
+
+	inline void clear()
+	{
+		keys.clear();
+		tracks.clear();
+		begins.clear();
+		durations.clear();
+	}
+
+	inline void shrinkToFit()
+	{
+		keys.shrink_to_fit();
+		tracks.shrink_to_fit();
+		begins.shrink_to_fit();
+		durations.shrink_to_fit();
+	}
+
+	//! @returns the index of the new note
+	inline std::size_t push(std::uint8_t key, std::uint16_t track, float begin, float duration)
+	{
+		keys.push_back(key);
+		tracks.push_back(track);
+		begins.push_back(begin);
+		durations.push_back(duration);
+
+		return keys.size() - 1;
+	}
+
+	inline void append(const SongTimeline &other)
+	{
+		keys.insert(keys.end(), other.keys.begin(), other.keys.end());
+		tracks.insert(tracks.end(), other.tracks.begin(), other.tracks.end());
+		begins.insert(begins.end(), other.begins.begin(), other.begins.end());
+		durations.insert(durations.end(), other.durations.begin(), other.durations.end());
+	}
+};
+
+#endif // !defined(PIANO_SONG_TIMELINE_H)
@@ -2,50 +2,62 @@
 
 #include <assert.h>
 
-void Sounds::lockOctave(std::size_t n)
+Sounds::Sounds() : m_words(), m_writes_begun(0), m_writes_ended(0)
 {
-	assert(("n must be less than the number of supported octaves.", n < NUM_OCTAVES));
-	m_sound_mutexes[n].lock();
-}
-
-void Sounds::unlockOctave(std::size_t n)
-{
-	assert(("n must be less than the number of supported octaves.", n < NUM_OCTAVES));
-	m_sound_mutexes[n].unlock();
+	for (auto &word : m_words)
+		word = 0;
 }
 
 void Sounds::toggleNote(Note note, bool on)
 {
-	m_sounds[note.octave][std::uint8_t(note.key)] = on;
+	assert(note.octave < NUM_OCTAVES && "The note's octave must be less than the number of supported octaves.");
+
+	const std::size_t index = Snapshot::index(note);
+	const std::uint64_t mask = std::uint64_t(1) << (index % 64);
+
+	m_writes_begun.fetch_add(1);
+
+	if (on)
+		m_words[index / 64].fetch_or(mask);
+	else
+		m_words[index / 64].fetch_and(~mask);
+
+	m_writes_ended.fetch_add(1);
 }
 
-void Sounds::safeToggleNote(Note note, bool on)
+void Sounds::apply(const Snapshot &pressed, const Snapshot &released)
 {
-	lockOctave(note.octave);
-	m_sounds[note.octave][std::uint8_t(note.key)] = on;
-	unlockOctave(note.octave);
+	m_writes_begun.fetch_add(1);
+
+	for (std::size_t i = 0; i < NUM_WORDS; i++) {
+		if (pressed.words[i] != 0)
+			m_words[i].fetch_or(pressed.words[i]);
+
+		if (released.words[i] != 0)
+			m_words[i].fetch_and(~released.words[i]);
+	}
+
+	m_writes_ended.fetch_add(1);
 }
 
-bool Sounds::checkNote(Note note)
+bool Sounds::checkNote(Note note) const
 {
-	return m_sounds[note.octave][std::uint8_t(note.key)];
+	const std::size_t index = Snapshot::index(note);
+	return (m_words[index / 64].load() >> (index % 64)) & 1u;
 }
 
-std::unordered_set<Note> Sounds::toNotes()
+Sounds::Snapshot Sounds::snapshot() const
 {
-	std::unordered_set<Note> result;
-	result.reserve(ACTIVE_NOTES_ESTIMATE);
+	Snapshot result{};
 
-	for (std::size_t i = 0; i < NUM_OCTAVES; i++) {
-		lockOctave(i);
-		const auto &octave = m_sounds[i];
+	for (;;) {
+		const std::uint64_t ended = m_writes_ended.load();
 
-		for (std::size_t j = 0; j < 12; j++)
-			if (octave[j])
-				result.insert(Note{Note::Key(j), std::uint8_t(i)});
+		for (std::size_t i = 0; i < NUM_WORDS; i++)
+			result.words[i] = m_words[i].load();
 
-		unlockOctave(i);
+		// No write was in progress when we started, and none began while we were reading
+		if (m_writes_begun.load() == ended)
+			return result;
 	}
-
-	return result;
 }
\ No newline at end of file
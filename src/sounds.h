@@ -2,30 +2,101 @@
 #define PIANO_SOUNDS_H
 
 #include <array>
-#include <bitset>
-#include <mutex>
-#include <unordered_set>
+#include <atomic>
+#include <cstdint>
 
+#include "bits.h"
 #include "notes.h"
 
+//! The state of every key, shared between the serial, audio and graphics threads
+//! without locks. Writers flip single bits atomically; readers take consistent
+//! snapshot()s of the whole keyboard.
 struct Sounds {
 public:
 	constexpr static const std::size_t NUM_OCTAVES = 8;
-	constexpr static const std::size_t ACTIVE_NOTES_ESTIMATE = 4;
+	constexpr static const std::size_t NUM_NOTES = NUM_OCTAVES * 12;
+	constexpr static const std::size_t NUM_WORDS = (NUM_NOTES + 63) / 64;
+
+	//! A copy of the whole keyboard, one bit per note
+	struct Snapshot {
+		std::array<std::uint64_t, NUM_WORDS> words;
+
+		constexpr static std::size_t index(Note note) { return note.octave * 12 + std::size_t(note.key); }
+
+		constexpr void set(Note note, bool on = true)
+		{
+			const std::uint64_t mask = std::uint64_t(1) << (index(note) % 64);
+			words[index(note) / 64] = on ? (words[index(note) / 64] | mask) : (words[index(note) / 64] & ~mask);
+		}
+
+		constexpr bool test(Note note) const { return (words[index(note) / 64] >> (index(note) % 64)) & 1u; }
+
+		constexpr bool empty() const
+		{
+			for (const auto word : words)
+				if (word != 0)
+					return false;
+
+			return true;
+		}
+
+		constexpr Snapshot operator^(const Snapshot &other) const
+		{
+			Snapshot result{};
+			for (std::size_t i = 0; i < NUM_WORDS; i++)
+				result.words[i] = words[i] ^ other.words[i];
+			return result;
+		}
+
+		constexpr Snapshot operator&(const Snapshot &other) const
+		{
+			Snapshot result{};
+			for (std::size_t i = 0; i < NUM_WORDS; i++)
+				result.words[i] = words[i] & other.words[i];
+			return result;
+		}
+
+		constexpr Snapshot operator|(const Snapshot &other) const
+		{
+			Snapshot result{};
+			for (std::size_t i = 0; i < NUM_WORDS; i++)
+				result.words[i] = words[i] | other.words[i];
+			return result;
+		}
+
+		constexpr bool operator==(const Snapshot &other) const { return (*this ^ other).empty(); }
+		constexpr bool operator!=(const Snapshot &other) const { return !(*this == other); }
+
+		//! Calls fn(Note) for every note that is set
+		template <typename Fn>
+		void forEach(Fn &&fn) const
+		{
+			for (std::size_t i = 0; i < NUM_WORDS; i++) {
+				for (std::uint64_t word = words[i]; word != 0; word &= word - 1) {
+					const std::size_t n = i * 64 + lowestBit(word);
+					fn(Note{Note::Key(n % 12), std::uint8_t(n / 12)});
+				}
+			}
+		}
+	};
 
 private:
-	std::array<std::bitset<12>, NUM_OCTAVES> m_sounds;
-	std::array<std::mutex, NUM_OCTAVES> m_sound_mutexes;
+	std::array<std::atomic<std::uint64_t>, NUM_WORDS> m_words;
+
+	//! A snapshot is consistent if no write began or ended while it was being read
+	std::atomic<std::uint64_t> m_writes_begun;
+	std::atomic<std::uint64_t> m_writes_ended;
 
 public:
-	void lockOctave(std::size_t n);
-	void unlockOctave(std::size_t n);
+	Sounds();
 
 	void toggleNote(Note note, bool on);
-	void safeToggleNote(Note note, bool on);
-	bool checkNote(Note note);
+	bool checkNote(Note note) const;
+
+	//! Presses and releases several notes as a single change
+	void apply(const Snapshot &pressed, const Snapshot &released);
 
-	std::unordered_set<Note> toNotes();
+	Snapshot snapshot() const;
 
 	inline void clearNote(Note note) { toggleNote(note, false); }
 	inline void setNote(Note note) { toggleNote(note, true); }
@@ -0,0 +1,77 @@
+#ifndef PIANO_SPSC_QUEUE_H
+#define PIANO_SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+//! A bounded wait-free queue between exactly one producer thread and one consumer thread.
+//! Capacity must be a power of two; one slot is never used.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+	constexpr static const std::size_t CACHE_LINE_SIZE = 64;
+
+private:
+	//! Only written by the producer
+	alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_head;
+	//! Only written by the consumer
+	alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_tail;
+
+	alignas(CACHE_LINE_SIZE) std::array<T, Capacity> m_items;
+
+public:
+	SpscQueue() : m_head(0), m_tail(0), m_items() {}
+
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+
+	//! @returns false if the queue is full
+	bool push(const T &item)
+	{
+		const std::size_t head = m_head.load(std::memory_order_relaxed);
+		const std::size_t next = (head + 1) & (Capacity - 1);
+
+		if (next == m_tail.load(std::memory_order_acquire))
+			return false;
+
+		m_items[head] = item;
+		m_head.store(next, std::memory_order_release);
+
+		return true;
+	}
+
+	//! @returns false if the queue is empty
+	bool pop(T &item)
+	{
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (tail == m_head.load(std::memory_order_acquire))
+			return false;
+
+		item = m_items[tail];
+		m_tail.store((tail + 1) & (Capacity - 1), std::memory_order_release);
+
+		return true;
+	}
+
+	//! Reads the next item without removing it; only called by the consumer
+	//! @returns false if the queue is empty
+	bool peek(T &item) const
+	{
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (tail == m_head.load(std::memory_order_acquire))
+			return false;
+
+		item = m_items[tail];
+
+		return true;
+	}
+
+	bool empty() const { return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire); }
+};
+
+#endif // !defined(PIANO_SPSC_QUEUE_H)
\ No newline at end of file
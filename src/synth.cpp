@@ -0,0 +1,77 @@
+#include "synth.h"
+
+#include <algorithm>
+
+Synth::Synth(OscillatorBank::Waveform waveform, unsigned polyphony, OscillatorBank::Kernel kernel)
+    : m_bank(waveform, kernel), m_voices(), m_polyphony(std::min<std::size_t>(polyphony, OscillatorBank::CAPACITY)), m_started(0),
+      m_attack_step(1.0f / (ATTACK_SECONDS * float(SAMPLE_RATE))),
+      m_release_step(1.0f / (RELEASE_SECONDS * float(SAMPLE_RATE)))
+{
+	m_voices.reserve(m_polyphony);
+}
+
+void Synth::noteOn(Note note)
+{
+	// A note pressed again while it still sounds keeps its voice, so it doesn't double up
+	auto voice = std::find_if(m_voices.begin(), m_voices.end(), [note](const Voice &v) { return v.note == note; });
+
+	if (voice == m_voices.end()) {
+		if (m_voices.size() == m_polyphony) {
+			// Steal the quietest releasing voice, or the oldest one if all are held
+			const auto stolen = std::min_element(m_voices.begin(), m_voices.end(), [this](const Voice &a, const Voice &b) {
+				return a.held != b.held ? !a.held : (a.held ? a.started < b.started : m_bank.gain(&a - m_voices.data()) < m_bank.gain(&b - m_voices.data()));
+			});
+
+			const std::size_t index = std::size_t(stolen - m_voices.begin());
+			m_bank.remove(index);
+			m_voices[index] = m_voices.back();
+			m_voices.pop_back();
+		}
+
+		m_bank.add(std::uint32_t(double(note.toPitch()) / double(SAMPLE_RATE) * 4294967296.0));
+		m_voices.push_back(Voice{note, true, 0});
+		voice = m_voices.end() - 1;
+	}
+
+	voice->held = true;
+	voice->started = ++m_started;
+	m_bank.setGainStep(std::size_t(voice - m_voices.begin()), m_attack_step);
+}
+
+void Synth::noteOff(Note note)
+{
+	for (std::size_t i = 0; i < m_voices.size(); i++) {
+		if (m_voices[i].note == note && m_voices[i].held) {
+			m_voices[i].held = false;
+			m_bank.setGainStep(i, -m_release_step);
+		}
+	}
+}
+
+void Synth::allNotesOff()
+{
+	m_bank.clear();
+	m_voices.clear();
+}
+
+void Synth::render(float *out, std::size_t frames)
+{
+	std::fill(out, out + frames, 0.0f);
+
+	m_bank.render(out, frames);
+
+	for (std::size_t i = 0; i < frames; i++)
+		out[i] *= VOICE_GAIN;
+
+	// Released voices that faded out make room for new ones
+	for (std::size_t i = 0; i < m_voices.size();) {
+		if (!m_voices[i].held && m_bank.gain(i) <= 0.0f) {
+			m_bank.remove(i);
+			m_voices[i] = m_voices.back();
+			m_voices.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef PIANO_SYNTH_H
+#define PIANO_SYNTH_H
+
+#include "instrument.h"
+#include "notes.h"
+#include "oscillator_bank.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Renders the notes of the built-in waveforms into one mono stream, a block at a time.
+//! Each voice is a phase accumulator whose gain ramps up on noteOn and down on noteOff,
+//! so the cost per block only depends on the number of sounding voices.
+class Synth : public Instrument {
+public:
+	constexpr static const float ATTACK_SECONDS = 0.005f;
+	constexpr static const float RELEASE_SECONDS = 0.03f;
+	//! Leaves headroom for a few voices before the mix clips
+	constexpr static const float VOICE_GAIN = 0.25f;
+
+private:
+	//! What the oscillator bank doesn't need, at the same index as its oscillator
+	struct Voice {
+		Note note;
+		bool held;
+		std::uint64_t started;
+	};
+
+	OscillatorBank m_bank;
+	std::vector<Voice> m_voices;
+	std::size_t m_polyphony;
+	std::uint64_t m_started;
+
+	float m_attack_step;
+	float m_release_step;
+
+public:
+	Synth(OscillatorBank::Waveform waveform, unsigned polyphony, OscillatorBank::Kernel kernel = OscillatorBank::bestKernel().kernel);
+
+	void noteOn(Note note) override;
+	void noteOff(Note note) override;
+	void allNotesOff() override;
+
+	void render(float *out, std::size_t frames) override;
+
+	inline bool active() const override { return !m_voices.empty(); }
+};
+
+#endif // !defined(PIANO_SYNTH_H)
\ No newline at end of file
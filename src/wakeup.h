@@ -0,0 +1,57 @@
+#ifndef PIANO_WAKEUP_H
+#define PIANO_WAKEUP_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+//! Puts a consumer thread to sleep until a producer has something for it.
+//! The producer only takes the mutex while the consumer is actually asleep.
+class Wakeup {
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	//! Lets notify() skip the mutex while the consumer is busy
+	std::atomic_bool m_waiting;
+	//! Guarded by m_mutex
+	bool m_notified;
+
+public:
+	Wakeup() : m_mutex(), m_condition(), m_waiting(false), m_notified(false) {}
+
+	//! Blocks the consumer until ready() holds, notify() is called or the deadline passes
+	template <typename Clock, typename Duration, typename Ready>
+	void waitUntil(std::chrono::time_point<Clock, Duration> deadline, Ready ready)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_waiting = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		m_condition.wait_until(lock, deadline, [this, &ready] { return m_notified || ready(); });
+
+		m_waiting = false;
+		m_notified = false;
+	}
+
+	//! Called by the producer after making ready() hold, or to wake the consumer for any other reason
+	void notify()
+	{
+		// Pairs with the fence in waitUntil(): either the consumer sees the new work
+		// before it blocks, or we see that it's waiting
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (!m_waiting)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_notified = true;
+		}
+
+		m_condition.notify_one();
+	}
+};
+
+#endif // !defined(PIANO_WAKEUP_H)
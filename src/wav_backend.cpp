@@ -0,0 +1,61 @@
+#include "wav_backend.h"
+
+#include <chrono>
+#include <iostream>
+
+WavBackend::WavBackend(std::unique_ptr<Instrument> instrument, std::string path)
+    : AudioBackend(), m_path(std::move(path)), m_instrument(std::move(instrument)), m_volume(1.0f), m_writer(), m_block(),
+      m_running(false), m_thread() {}
+
+WavBackend::~WavBackend()
+{
+	end();
+}
+
+bool WavBackend::begin()
+{
+	if (m_thread.joinable())
+		return false;
+
+	if (!m_writer.open(m_path, Instrument::SAMPLE_RATE, 1))
+		return false;
+
+	m_running = true;
+	m_thread = std::thread(&WavBackend::renderThread, this);
+
+	return true;
+}
+
+void WavBackend::end()
+{
+	if (!m_thread.joinable())
+		return;
+
+	m_running = false;
+	m_thread.join();
+
+	if (!m_writer.close())
+		std::cerr << "Couldn't finish writing " << m_path << "." << std::endl;
+	else
+		std::cout << "Recorded " << double(m_writer.frames()) / double(Instrument::SAMPLE_RATE) << " s of audio to " << m_path << "." << std::endl;
+
+	m_instrument->allNotesOff();
+}
+
+void WavBackend::renderThread()
+{
+	const auto block = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	    std::chrono::duration<double>(double(Instrument::BLOCK_SIZE) / double(Instrument::SAMPLE_RATE)));
+
+	auto next = std::chrono::steady_clock::now();
+
+	// Paced by the clock like a device would be; commands wait at most a block
+	while (m_running) {
+		applyCommands(*m_instrument, m_volume);
+		renderBlock(*m_instrument, m_volume, m_block.data(), m_block.size());
+		m_writer.write(m_block.data(), m_block.size());
+
+		next += block;
+		std::this_thread::sleep_until(next);
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef PIANO_WAV_BACKEND_H
+#define PIANO_WAV_BACKEND_H
+
+#include "audio_backend.h"
+#include "instrument.h"
+#include "wav_writer.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+//! Records a software instrument into a WAV file in real time instead of playing it,
+//! silence included, so the file keeps the timing of the session
+class WavBackend : public AudioBackend {
+private:
+	std::string m_path;
+
+	//! Only used by the render thread from here on
+	std::unique_ptr<Instrument> m_instrument;
+	float m_volume;
+	WavWriter m_writer;
+	std::array<float, Instrument::BLOCK_SIZE> m_block;
+
+	std::atomic_bool m_running;
+	std::thread m_thread;
+
+	void renderThread();
+
+public:
+	WavBackend(std::unique_ptr<Instrument> instrument, std::string path);
+	~WavBackend() override;
+
+	bool begin() override;
+	void end() override;
+};
+
+#endif // !defined(PIANO_WAV_BACKEND_H)
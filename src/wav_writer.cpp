@@ -0,0 +1,94 @@
+#include "wav_writer.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+constexpr static const std::uint32_t HEADER_SIZE = 44;
+constexpr static const std::uint16_t BITS_PER_SAMPLE = 16;
+
+void writeLittleEndian(std::ofstream &file, std::uint32_t value, unsigned bytes)
+{
+	for (unsigned i = 0; i < bytes; i++)
+		file.put(char((value >> (8 * i)) & 0xFF));
+}
+} // namespace
+
+WavWriter::WavWriter() : m_file(), m_channels(1), m_frames(0), m_buffer() {}
+
+WavWriter::~WavWriter()
+{
+	if (m_file.is_open())
+		close();
+}
+
+void WavWriter::writeHeader(unsigned sample_rate)
+{
+	const std::uint32_t block_align = m_channels * BITS_PER_SAMPLE / 8;
+	const std::uint32_t data_size = m_frames * block_align;
+
+	m_file.write("RIFF", 4);
+	writeLittleEndian(m_file, HEADER_SIZE - 8 + data_size, 4);
+	m_file.write("WAVE", 4);
+
+	m_file.write("fmt ", 4);
+	writeLittleEndian(m_file, 16, 4);
+	writeLittleEndian(m_file, 1, 2); // PCM
+	writeLittleEndian(m_file, m_channels, 2);
+	writeLittleEndian(m_file, sample_rate, 4);
+	writeLittleEndian(m_file, sample_rate * block_align, 4);
+	writeLittleEndian(m_file, block_align, 2);
+	writeLittleEndian(m_file, BITS_PER_SAMPLE, 2);
+
+	m_file.write("data", 4);
+	writeLittleEndian(m_file, data_size, 4);
+}
+
+bool WavWriter::open(const std::string &path, unsigned sample_rate, unsigned channels)
+{
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file) {
+		std::cerr << "Couldn't open " << path << " for writing." << std::endl;
+		return false;
+	}
+
+	m_channels = channels;
+	m_frames = 0;
+
+	// The sizes are zero until close() knows them
+	writeHeader(sample_rate);
+
+	return bool(m_file);
+}
+
+void WavWriter::write(const float *samples, std::size_t count)
+{
+	m_buffer.resize(count * 2);
+
+	// Stored little-endian whatever the host is
+	for (std::size_t i = 0; i < count; i++) {
+		const auto sample = std::uint16_t(std::int16_t(std::min(1.0f, std::max(-1.0f, samples[i])) * 32767.0f));
+
+		m_buffer[2 * i] = std::uint8_t(sample & 0xFF);
+		m_buffer[2 * i + 1] = std::uint8_t(sample >> 8);
+	}
+
+	m_file.write(reinterpret_cast<const char *>(m_buffer.data()), std::streamsize(m_buffer.size()));
+
+	m_frames += std::uint32_t(count / m_channels);
+}
+
+bool WavWriter::close()
+{
+	const std::uint32_t data_size = m_frames * m_channels * BITS_PER_SAMPLE / 8;
+
+	m_file.seekp(4);
+	writeLittleEndian(m_file, HEADER_SIZE - 8 + data_size, 4);
+	m_file.seekp(HEADER_SIZE - 4);
+	writeLittleEndian(m_file, data_size, 4);
+
+	const bool result = bool(m_file);
+	m_file.close();
+
+	return result;
+}
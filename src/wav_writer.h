@@ -0,0 +1,36 @@
+#ifndef PIANO_WAV_WRITER_H
+#define PIANO_WAV_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//! Writes 16-bit PCM WAV files from float samples in [-1, 1]. The sizes in the
+//! header are filled in by close().
+class WavWriter {
+private:
+	std::ofstream m_file;
+	unsigned m_channels;
+	std::uint32_t m_frames;
+
+	std::vector<std::uint8_t> m_buffer;
+
+	void writeHeader(unsigned sample_rate);
+
+public:
+	WavWriter();
+	~WavWriter();
+
+	bool open(const std::string &path, unsigned sample_rate, unsigned channels);
+
+	//! @param count the number of samples, interleaved if there are several channels
+	void write(const float *samples, std::size_t count);
+
+	bool close();
+
+	inline std::uint32_t frames() const { return m_frames; }
+};
+
+#endif // !defined(PIANO_WAV_WRITER_H)
\ No newline at end of file
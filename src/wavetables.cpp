@@ -0,0 +1,73 @@
+#include "wavetables.h"
+
+#include "bits.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include <algorithm>
+
+Wavetables::Wavetables() : m_samples(NUM_WAVEFORMS * NUM_LEVELS * TABLE_STRIDE)
+{
+	// Harmonic k of sample i is sine[k * i % TABLE_SIZE], so no further sin() calls are needed
+	std::vector<double> sine(TABLE_SIZE);
+	for (std::size_t i = 0; i < TABLE_SIZE; i++)
+		sine[i] = sin(M_PI * 2.0 * double(i) / double(TABLE_SIZE));
+
+	std::vector<double> sum(TABLE_SIZE);
+
+	for (std::size_t level = 0; level < NUM_LEVELS; level++) {
+		const std::size_t harmonics = std::size_t(1) << (MAX_HARMONIC_BITS - level);
+
+		for (std::size_t waveform = 0; waveform < NUM_WAVEFORMS; waveform++) {
+			std::fill(sum.begin(), sum.end(), 0.0);
+
+			switch (Waveform(waveform)) {
+				case WAVEFORM_SINE:
+					sum = sine;
+					break;
+
+				case WAVEFORM_SQUARE:
+					// +1 for the first half of the period, -1 for the second
+					for (std::size_t k = 1; k <= harmonics; k += 2) {
+						for (std::size_t i = 0; i < TABLE_SIZE; i++)
+							sum[i] += 4.0 / (M_PI * double(k)) * sine[k * i % TABLE_SIZE];
+					}
+					break;
+
+				case WAVEFORM_TRIANGLE:
+					// -1 at the start of the period, 1 in the middle
+					for (std::size_t k = 1; k <= harmonics; k += 2) {
+						for (std::size_t i = 0; i < TABLE_SIZE; i++)
+							sum[i] -= 8.0 / (M_PI * M_PI * double(k * k)) * sine[(k * i + TABLE_SIZE / 4) % TABLE_SIZE];
+					}
+					break;
+			}
+
+			float *table = m_samples.data() + (waveform * NUM_LEVELS + level) * TABLE_STRIDE;
+
+			for (std::size_t i = 0; i < TABLE_SIZE; i++)
+				table[i] = float(sum[i]);
+
+			table[TABLE_SIZE] = table[0];
+		}
+	}
+}
+
+/* static */ const Wavetables &Wavetables::instance()
+{
+	static const Wavetables tables;
+	return tables;
+}
+
+/* static */ std::uint32_t Wavetables::offset(Waveform waveform, std::uint32_t increment)
+{
+	// A table may only be played by increments below 2^(31 - log2(harmonics)), so its
+	// highest harmonic stays under half the sample rate
+	constexpr unsigned FIRST_LEVEL_BIT = 30 - MAX_HARMONIC_BITS;
+
+	const unsigned bit = increment != 0 ? highestBit(increment) : 0;
+	const std::size_t level = std::min<std::size_t>(bit > FIRST_LEVEL_BIT ? bit - FIRST_LEVEL_BIT : 0, NUM_LEVELS - 1);
+
+	return std::uint32_t((std::size_t(waveform) * NUM_LEVELS + level) * TABLE_STRIDE);
+}
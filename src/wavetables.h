@@ -0,0 +1,49 @@
+#ifndef PIANO_WAVETABLES_H
+#define PIANO_WAVETABLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Single periods of the synth waveforms, band-limited so that none of their
+//! harmonics reach the Nyquist frequency. Every waveform has one table per
+//! octave of pitch; higher octaves keep fewer harmonics.
+//!
+//! The tables are built once and shared read-only by every voice.
+class Wavetables {
+public:
+	enum Waveform : std::uint8_t {
+		WAVEFORM_SINE,
+		WAVEFORM_SQUARE,
+		WAVEFORM_TRIANGLE
+	};
+
+	constexpr static const std::size_t NUM_WAVEFORMS = 3;
+
+	constexpr static const unsigned TABLE_BITS = 11;
+	constexpr static const std::size_t TABLE_SIZE = std::size_t(1) << TABLE_BITS;
+	//! The first sample is repeated after the last, for interpolation
+	constexpr static const std::size_t TABLE_STRIDE = TABLE_SIZE + 1;
+	//! The bits of a 32-bit phase below the table index
+	constexpr static const unsigned FRACTION_BITS = 32 - TABLE_BITS;
+
+	//! The first level has 2^MAX_HARMONIC_BITS harmonics, enough for the lowest piano notes at 48 kHz
+	constexpr static const unsigned MAX_HARMONIC_BITS = 9;
+	constexpr static const std::size_t NUM_LEVELS = MAX_HARMONIC_BITS + 1;
+
+private:
+	std::vector<float> m_samples;
+
+	Wavetables();
+
+public:
+	static const Wavetables &instance();
+
+	inline const float *data() const { return m_samples.data(); }
+
+	//! Where the table for a waveform played with a phase increment per sample
+	//! (2^32 is a full period) starts in data()
+	static std::uint32_t offset(Waveform waveform, std::uint32_t increment);
+};
+
+#endif // !defined(PIANO_WAVETABLES_H)
\ No newline at end of file
@@ -33,9 +33,10 @@
 	COMMTIMEOUTS timeout = {0};
 	GetCommTimeouts(serialHandle, &timeout);
 
-	timeout.ReadIntervalTimeout = 0;
-	timeout.ReadTotalTimeoutConstant = 0;
-	timeout.ReadTotalTimeoutMultiplier = 0;
+	// Return whatever is buffered right away, or wait up to READ_TIMEOUT_MS for the first byte
+	timeout.ReadIntervalTimeout = MAXDWORD;
+	timeout.ReadTotalTimeoutConstant = READ_TIMEOUT_MS;
+	timeout.ReadTotalTimeoutMultiplier = MAXDWORD;
 
 	if (!SetCommTimeouts(serialHandle, &timeout)) {
 		CloseHandle(serialHandle);
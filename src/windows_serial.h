@@ -5,6 +5,9 @@
 #include <windows.h>
 
 class WindowsSerial : public Serial {
+public:
+	constexpr static const DWORD READ_TIMEOUT_MS = 10;
+
 protected:
 	HANDLE serialHandle;
 
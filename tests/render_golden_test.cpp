@@ -0,0 +1,115 @@
+#include "offline_renderer.h"
+#include "oscillator_bank.h"
+#include "synth.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! Renders a short phrase with each waveform through the scalar kernel and compares
+//! it to the WAV files in the data directory. Run with --update to rewrite them after
+//! an intended change to the sound.
+
+namespace {
+//! A sample may be off by one step, to allow for another compiler's rounding
+constexpr static const int TOLERANCE = 1;
+constexpr static const std::size_t WAV_HEADER_SIZE = 44;
+
+struct Golden {
+	const char *name;
+	OscillatorBank::Waveform waveform;
+};
+
+const Golden GOLDENS[] = {
+    {"sine", Wavetables::WAVEFORM_SINE},
+    {"square", Wavetables::WAVEFORM_SQUARE},
+    {"triangle", Wavetables::WAVEFORM_TRIANGLE}};
+
+bool readFile(const std::string &path, std::vector<char> &bytes)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Couldn't open " << path << "." << std::endl;
+		return false;
+	}
+
+	bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+int sampleAt(const std::vector<char> &bytes, std::size_t index)
+{
+	const std::size_t offset = WAV_HEADER_SIZE + 2 * index;
+	return int(std::int16_t(std::uint16_t(std::uint8_t(bytes[offset])) | std::uint16_t(std::uint8_t(bytes[offset + 1]) << 8)));
+}
+
+//! A chord with a note starting and stopping inside it, between block boundaries
+bool render(const Golden &golden, const std::string &path)
+{
+	OfflineRenderer renderer(std::make_unique<Synth>(golden.waveform, 8, OscillatorBank::scalarKernel().kernel), 0.5f);
+
+	renderer.addNote(Note::fromMidi(60), 0.0, 0.1);
+	renderer.addNote(Note::fromMidi(64), 0.0, 0.1);
+	renderer.addNote(Note::fromMidi(67), 0.01, 0.09);
+	renderer.addNote(Note::fromMidi(81), 0.0503, 0.0251);
+	renderer.addNote(Note::fromMidi(33), 0.07, 0.03);
+
+	return renderer.render(path);
+}
+
+bool compare(const Golden &golden, const std::string &rendered, const std::string &reference)
+{
+	std::vector<char> actual, expected;
+	if (!readFile(rendered, actual) || !readFile(reference, expected))
+		return false;
+
+	if (actual.size() != expected.size() || std::memcmp(actual.data(), expected.data(), WAV_HEADER_SIZE) != 0) {
+		std::cerr << golden.name << ": the render is " << actual.size() << " bytes, the reference " << expected.size() << "." << std::endl;
+		return false;
+	}
+
+	const std::size_t samples = (actual.size() - WAV_HEADER_SIZE) / 2;
+
+	for (std::size_t i = 0; i < samples; i++) {
+		const int difference = std::abs(sampleAt(actual, i) - sampleAt(expected, i));
+
+		if (difference > TOLERANCE) {
+			std::cerr << golden.name << ": sample " << i << " is " << sampleAt(actual, i) << ", the reference has " << sampleAt(expected, i) << "." << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " DATA_DIRECTORY [--update]" << std::endl;
+		return 2;
+	}
+
+	const std::string directory = argv[1];
+	const bool update = argc > 2 && std::string(argv[2]) == "--update";
+
+	int failures = 0;
+
+	for (const auto &golden : GOLDENS) {
+		const std::string reference = directory + "/render_" + golden.name + ".wav";
+		const std::string rendered = update ? reference : std::string("render_") + golden.name + ".wav";
+
+		if (!render(golden, rendered) || (!update && !compare(golden, rendered, reference)))
+			failures++;
+		else
+			std::cout << golden.name << (update ? ": updated" : ": ok") << std::endl;
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+#include "serial_notes.h"
+#include "serial_parser.h"
+
+#include <CLI/CLI.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+using scan_clock = std::chrono::steady_clock;
+
+struct LoadSettings {
+	double rate;
+	double density;
+	double hold_ms;
+	double chatter;
+	double duration;
+	bool binary;
+};
+
+//! A keyboard whose keys go down and up at random so that on average
+//! `density` of them are held, each for about `hold_ms`
+class SyntheticKeyboard {
+private:
+	const KeyMap &m_keymap;
+	std::mt19937 m_rng;
+	std::bernoulli_distribution m_press, m_release, m_chatter;
+
+	std::array<std::uint16_t, KeyMap::MAX_ROWS> m_state;
+	std::uint8_t m_sequence;
+
+public:
+	SyntheticKeyboard(const KeyMap &keymap, const LoadSettings &settings)
+	    : m_keymap(keymap), m_rng(std::random_device{}()), m_state(), m_sequence(0)
+	{
+		const double release = std::min(1.0, 1000.0 / (settings.hold_ms * settings.rate));
+		const double press = settings.density >= 1.0 ? 1.0 : std::min(1.0, release * settings.density / (1.0 - settings.density));
+
+		m_press = std::bernoulli_distribution(press);
+		m_release = std::bernoulli_distribution(release);
+		m_chatter = std::bernoulli_distribution(settings.chatter);
+	}
+
+	//! Advances the keyboard by one scan period
+	void step()
+	{
+		for (std::size_t row = 0; row < m_keymap.rows(); row++) {
+			for (std::size_t bit = 0; bit < m_keymap.rowBits(); bit++) {
+				const std::uint16_t mask = std::uint16_t(1u << bit);
+				if ((m_keymap.mask(row) & mask) == 0)
+					continue;
+
+				const bool down = (m_state[row] & mask) != 0;
+				if (down ? m_release(m_rng) : m_press(m_rng))
+					m_state[row] ^= mask;
+			}
+		}
+	}
+
+	//! What the scanner reports for a row
+	std::uint16_t scanRow(std::size_t row)
+	{
+		std::uint16_t bits = m_state[row];
+
+		// A bouncing contact shows the opposite state for a single scan
+		for (std::size_t bit = 0; bit < m_keymap.rowBits(); bit++) {
+			if ((m_keymap.mask(row) & (1u << bit)) != 0 && m_chatter(m_rng))
+				bits ^= std::uint16_t(1u << bit);
+		}
+
+		return bits;
+	}
+
+	void writeAscii(std::vector<std::uint8_t> &out)
+	{
+		for (std::size_t row = 0; row < m_keymap.rows(); row++) {
+			const std::uint16_t bits = scanRow(row);
+
+			out.push_back("0123456789abcdef"[row]);
+			for (std::size_t bit = m_keymap.rowBits(); bit-- > 0;)
+				out.push_back((bits >> bit) & 1u ? '1' : '0');
+
+			out.push_back('\r');
+			out.push_back('\n');
+		}
+	}
+
+	void writeBinary(std::vector<std::uint8_t> &out)
+	{
+		std::uint8_t payload[SerialParser::MAX_FRAME_PAYLOAD_SIZE];
+		std::size_t size = 0;
+
+		payload[size++] = m_sequence++;
+
+		for (std::size_t row = 0; row < m_keymap.rows(); row++) {
+			const std::uint16_t bits = scanRow(row);
+
+			if (m_keymap.rowBytes() == 2)
+				payload[size++] = std::uint8_t(bits >> 8);
+
+			payload[size++] = std::uint8_t(bits);
+		}
+
+		out.push_back(SerialParser::SYNC_BYTE);
+		out.insert(out.end(), payload, payload + size);
+		out.push_back(SerialParser::crc8(payload, size));
+	}
+};
+
+int openPseudoTerminal(std::string &slave_path, int &slave_fd)
+{
+	const int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+		return -1;
+
+	slave_path = ptsname(master);
+
+	// Keep the slave open in raw mode so the line discipline neither echoes nor
+	// hangs up on us before the app attaches
+	slave_fd = open(slave_path.c_str(), O_RDWR | O_NOCTTY);
+	if (slave_fd < 0) {
+		close(master);
+		return -1;
+	}
+
+	struct termios tio;
+	tcgetattr(slave_fd, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave_fd, TCSANOW, &tio);
+
+	return master;
+}
+
+bool writeAll(int fd, const std::vector<std::uint8_t> &data)
+{
+	std::size_t written = 0;
+	while (written < data.size()) {
+		const ssize_t result = write(fd, data.data() + written, data.size() - written);
+		if (result <= 0)
+			return false;
+
+		written += std::size_t(result);
+	}
+
+	return true;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	CLI::App commandLine("Synthetic piano keyboard on a pseudo terminal");
+
+	LoadSettings settings = {1000.0, 0.1, 150.0, 0.0, 0.0, false};
+	std::string keymap_path;
+
+	commandLine.add_option("-r,--rate", settings.rate, "Full keyboard scans per second")
+	    ->check(CLI::PositiveNumber);
+	commandLine.add_option("-d,--density", settings.density, "The average ratio of keys held down")
+	    ->check(CLI::Range(0.0, 1.0));
+	commandLine.add_option("--hold", settings.hold_ms, "The average time a key is held in milliseconds")
+	    ->check(CLI::PositiveNumber);
+	commandLine.add_option("-c,--chatter", settings.chatter, "The chance of a key reading wrong in a single scan")
+	    ->check(CLI::Range(0.0, 1.0));
+	commandLine.add_option("-t,--duration", settings.duration, "Stop after this many seconds. 0 runs until interrupted")
+	    ->check(CLI::NonNegativeNumber);
+	commandLine.add_flag("-b,--binary", settings.binary, "Send binary frames instead of ASCII lines");
+	commandLine.add_option("-k,--keymap", keymap_path, "The keymap describing the simulated scan matrix")
+	    ->check(CLI::ExistingFile);
+
+	CLI11_PARSE(commandLine, argc, argv);
+
+	KeyMap keymap = DEFAULT_KEYMAP;
+	if (!keymap_path.empty() && !keymap.loadFromFile(keymap_path))
+		return 1;
+
+	std::string slave_path;
+	int slave_fd = -1;
+	const int master_fd = openPseudoTerminal(slave_path, slave_fd);
+	if (master_fd < 0) {
+		std::cerr << "Couldn't open a pseudo terminal." << std::endl;
+		return 1;
+	}
+
+	std::cout << "Keyboard attached to " << slave_path << ", run: piano --port " << slave_path
+	          << (settings.binary ? " --protocol binary" : "") << std::endl;
+
+	SyntheticKeyboard keyboard(keymap, settings);
+	std::vector<std::uint8_t> buffer;
+
+	const auto period = std::chrono::duration<double>(1.0 / settings.rate);
+	const auto started = scan_clock::now();
+	auto last_report = started;
+
+	std::uint64_t scans = 0, bytes = 0, reported_scans = 0;
+
+	while (settings.duration <= 0.0 || scan_clock::now() - started < std::chrono::duration<double>(settings.duration)) {
+		const auto now = scan_clock::now();
+		const auto due = std::uint64_t(std::chrono::duration<double>(now - started) / period) + 1;
+
+		// At high rates several scans are due per wakeup; send them with one write
+		buffer.clear();
+		for (; scans < due; scans++) {
+			keyboard.step();
+
+			if (settings.binary)
+				keyboard.writeBinary(buffer);
+			else
+				keyboard.writeAscii(buffer);
+		}
+
+		if (!writeAll(master_fd, buffer)) {
+			std::cerr << "Writing to the pseudo terminal failed." << std::endl;
+			break;
+		}
+
+		bytes += buffer.size();
+
+		if (now - last_report >= std::chrono::seconds(1)) {
+			const double seconds = std::chrono::duration<double>(now - last_report).count();
+
+			std::cout << double(scans - reported_scans) / seconds << " scans/s, "
+			          << double(bytes) / seconds << " B/s" << std::endl;
+
+			reported_scans = scans;
+			bytes = 0;
+			last_report = now;
+		}
+
+		std::this_thread::sleep_until(started + std::chrono::duration_cast<scan_clock::duration>(period * double(scans)));
+	}
+
+	close(slave_fd);
+	close(master_fd);
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+#include "replay_serial.h"
+#include "serial_parser.h"
+#include "sounds.h"
+
+#include <CLI/CLI.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+std::vector<std::uint8_t> generateLines(const KeyMap &keymap, std::size_t count, double garbage_ratio, std::uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> row(0, int(keymap.rows()) - 1);
+	std::uniform_int_distribution<int> bit(0, 1);
+	std::bernoulli_distribution garbage(garbage_ratio);
+
+	std::vector<std::uint8_t> result;
+	result.reserve(count * (keymap.rowBits() + 3));
+
+	for (std::size_t i = 0; i < count; i++) {
+		if (garbage(rng)) {
+			// A frame that lost bytes on the wire
+			result.push_back("0123456789abcdef"[row(rng)]);
+			result.push_back('1');
+			result.push_back('\n');
+			continue;
+		}
+
+		result.push_back("0123456789abcdef"[row(rng)]);
+		for (std::size_t b = 0; b < keymap.rowBits(); b++)
+			result.push_back('0' + bit(rng));
+
+		result.push_back('\r');
+		result.push_back('\n');
+	}
+
+	return result;
+}
+
+std::vector<std::uint8_t> generateFrames(const KeyMap &keymap, std::size_t count, double garbage_ratio, std::uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> row(0, 0xFF);
+	std::bernoulli_distribution garbage(garbage_ratio);
+
+	std::vector<std::uint8_t> result;
+	result.reserve(count * SerialParser::frameSize(keymap));
+
+	const std::size_t payload_size = SerialParser::framePayloadSize(keymap);
+
+	for (std::size_t i = 0; i < count; i++) {
+		std::uint8_t payload[SerialParser::MAX_FRAME_PAYLOAD_SIZE];
+		payload[0] = std::uint8_t(i);
+
+		for (std::size_t b = 1; b < payload_size; b++)
+			payload[b] = std::uint8_t(row(rng));
+
+		result.push_back(SerialParser::SYNC_BYTE);
+		result.insert(result.end(), payload, payload + payload_size);
+		// A corrupted frame fails its CRC
+		result.push_back(SerialParser::crc8(payload, payload_size) ^ (garbage(rng) ? 0x01 : 0x00));
+	}
+
+	return result;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	CLI::App commandLine("SerialParser throughput benchmark");
+
+	std::size_t lines = 1000000;
+	std::size_t iterations = 20;
+	std::size_t chunk = SerialParser::READ_CHUNK_SIZE;
+	double garbage = 0.01;
+	bool binary = false;
+	std::string keymap_path;
+	std::string replay_path;
+
+	commandLine.add_option("-n,--lines", lines, "The number of scan lines or frames to generate");
+	commandLine.add_option("-i,--iterations", iterations, "The number of passes over the generated stream");
+	commandLine.add_option("-c,--chunk", chunk, "The number of bytes handed to the parser at once")
+	    ->check(CLI::PositiveNumber);
+	commandLine.add_option("-g,--garbage", garbage, "The ratio of malformed lines")
+	    ->check(CLI::Range(0.0, 1.0));
+	commandLine.add_flag("-b,--binary", binary, "Generate binary frames instead of ASCII lines");
+	commandLine.add_option("-k,--keymap", keymap_path, "The keymap to parse with")
+	    ->check(CLI::ExistingFile);
+	commandLine.add_option("-r,--replay", replay_path, "Parse a serial recording as fast as possible instead of generated input")
+	    ->check(CLI::ExistingFile);
+
+	CLI11_PARSE(commandLine, argc, argv);
+
+	KeyMap keymap = DEFAULT_KEYMAP;
+	if (!keymap_path.empty() && !keymap.loadFromFile(keymap_path))
+		return 1;
+
+	std::vector<std::uint8_t> stream;
+	if (replay_path.empty()) {
+		stream = binary ? generateFrames(keymap, lines, garbage, 1234) : generateLines(keymap, lines, garbage, 1234);
+	}
+	else {
+		// Load the recording through the same backend the app uses
+		ReplaySerial replay(0.0);
+		if (!replay.begin(replay_path, 0, Serial::ARDUINO_SETTINGS))
+			return 1;
+
+		std::uint8_t buffer[SerialParser::READ_CHUNK_SIZE];
+		while (!replay.finished()) {
+			const std::size_t count = replay.read(buffer, sizeof(buffer));
+			stream.insert(stream.end(), buffer, buffer + count);
+		}
+
+		replay.end();
+	}
+
+	Sounds sounds;
+	SerialParser parser(nullptr, &sounds, nullptr, &keymap);
+
+	const auto begin = std::chrono::steady_clock::now();
+
+	for (std::size_t i = 0; i < iterations; i++) {
+		for (std::size_t offset = 0; offset < stream.size(); offset += chunk)
+			parser.feed(stream.data() + offset, std::min(chunk, stream.size() - offset));
+	}
+
+	const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	const auto &stats = parser.statistics();
+
+	std::cout << "bytes:      " << stats.bytes << "\n"
+	          << "lines:      " << stats.lines << "\n"
+	          << "frames:     " << stats.frames << "\n"
+	          << "malformed:  " << stats.malformed << "\n"
+	          << "elapsed:    " << elapsed << " s\n"
+	          << "throughput: " << double(stats.lines + stats.frames + stats.malformed) / elapsed << " scans/s, "
+	          << double(stats.bytes) / elapsed / (1024.0 * 1024.0) << " MiB/s" << std::endl;
+
+	return 0;
+}
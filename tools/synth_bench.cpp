@@ -0,0 +1,89 @@
+#include "oscillator_bank.h"
+#include "synth.h"
+
+#include <CLI/CLI.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+const std::map<std::string, OscillatorBank::Waveform> WAVEFORM_MAP = {
+    {"sine", Wavetables::WAVEFORM_SINE},
+    {"square", Wavetables::WAVEFORM_SQUARE},
+    {"triangle", Wavetables::WAVEFORM_TRIANGLE}};
+
+//! A bank with every voice sounding at full gain at a random piano pitch
+void fillBank(OscillatorBank &bank, std::size_t voices, std::uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> midi(21, 108);
+
+	for (std::size_t i = 0; i < voices; i++) {
+		const double frequency = 440.0 * std::pow(2.0, double(midi(rng) - 69) / 12.0);
+		const std::size_t index = bank.add(std::uint32_t(frequency / double(Synth::SAMPLE_RATE) * 4294967296.0));
+
+		bank.setGain(index, 1.0f, 0.0f);
+	}
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	CLI::App commandLine("Oscillator kernel benchmark");
+
+	std::size_t voices = 128;
+	std::size_t blocks = 20000;
+	OscillatorBank::Waveform waveform = Wavetables::WAVEFORM_SINE;
+
+	commandLine.add_option("-n,--voices", voices, "The number of sounding voices")
+	    ->check(CLI::Range(std::size_t(1), OscillatorBank::CAPACITY));
+	commandLine.add_option("-b,--blocks", blocks, "The number of blocks to render per kernel")
+	    ->check(CLI::PositiveNumber);
+	commandLine.add_option("-w,--waveform", waveform, "The waveform to render: sine, square or triangle")
+	    ->transform(CLI::CheckedTransformer(WAVEFORM_MAP, CLI::ignore_case));
+
+	CLI11_PARSE(commandLine, argc, argv);
+
+	const double block_seconds = double(Synth::BLOCK_SIZE) / double(Synth::SAMPLE_RATE);
+
+	std::vector<float> reference(Synth::BLOCK_SIZE), block(Synth::BLOCK_SIZE);
+	{
+		OscillatorBank bank(waveform, OscillatorBank::availableKernels().front().kernel);
+		fillBank(bank, voices, 1234);
+		bank.render(reference.data(), reference.size());
+	}
+
+	std::cout << voices << " voices, " << Synth::BLOCK_SIZE << " frames per block at " << Synth::SAMPLE_RATE << " Hz" << std::endl;
+
+	for (const auto &kernel : OscillatorBank::availableKernels()) {
+		OscillatorBank bank(waveform, kernel.kernel);
+		fillBank(bank, voices, 1234);
+
+		// The first block also checks the kernel against the scalar one
+		std::fill(block.begin(), block.end(), 0.0f);
+		bank.render(block.data(), block.size());
+
+		float error = 0.0f;
+		for (std::size_t i = 0; i < block.size(); i++)
+			error = std::max(error, std::fabs(block[i] - reference[i]) / float(voices));
+
+		const auto begin = std::chrono::steady_clock::now();
+
+		for (std::size_t i = 0; i < blocks; i++)
+			bank.render(block.data(), block.size());
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / double(blocks);
+
+		std::cout << kernel.name << ": " << seconds * 1e6 << " us/block, "
+		          << seconds * 1e9 / double(voices * Synth::BLOCK_SIZE) << " ns/voice-frame, "
+		          << double(voices) * block_seconds / seconds << " voices/core, "
+		          << "max error " << error << std::endl;
+	}
+
+	return 0;
+}